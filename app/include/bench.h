@@ -0,0 +1,28 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <zephyr/device.h>
+
+/**
+ * @brief Benchmark a weather station through the ADC and GPIO emulators.
+ *
+ * Times the anemometer interrupt, speed readings over synthetic pulse trains, the vane
+ * decode over every vane voltage, and bulk uplink requests. Results are printed as "Bench"
+ * lines, ending with "Bench: done". The station is then left with a steady synthetic wind,
+ * so the pipeline can run end to end. The decoded values are checked by the
+ * tests/weather_station suite, not here.
+ *
+ * Must be called before the station is sampled.
+ *
+ * @param station A sparkfun,weather-meter-kit device on an emulated ADC and GPIO port.
+ *
+ * @return int Returns 0 on success, or a negative error code if the emulators could not
+ *         be driven.
+ */
+int bench_run(const struct device *station);
+
+#endif /* BENCH_H */
@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include <zephyr/net/socket.h>
+#include <stdint.h>
+
+#include "latency_hist.h"
+
+/**
+ * @brief Resolved-address cache counters.
+ */
+struct dns_cache_stats {
+    uint32_t hits;      /**< Lookups served from a fresh entry */
+    uint32_t misses;    /**< Lookups that had to resolve synchronously */
+    uint32_t stale;     /**< Lookups served from an expired entry */
+    uint32_t refreshes; /**< Successful background refreshes */
+    uint32_t failures;  /**< Failed resolutions, sync or background */
+};
+
+/**
+ * @brief Look up the address of the uplink host.
+ *
+ * Serves the cached address when there is one, so the caller never waits on the
+ * resolver once the host has been resolved. Expired entries are still served
+ * (the last known-good address) while a background refresh is scheduled. Only
+ * the very first lookup resolves synchronously.
+ *
+ * The cache holds a single host; the first call fixes which one.
+ *
+ * @param host Host name to resolve.
+ * @param port Service port, as passed to getaddrinfo().
+ * @param addr Destination for the resolved IPv4 address and port.
+ *
+ * @return int Returns 0 on success, or a negative error code if the host has
+ *         never been resolved.
+ */
+int dns_cache_lookup(const char *host, const char *port, struct sockaddr_in *addr);
+
+/**
+ * @brief Get a snapshot of the cache counters.
+ *
+ * @param out Destination for the counters.
+ */
+void dns_cache_get_stats(struct dns_cache_stats *out);
+
+/* Latency of dns_cache_lookup(), including the synchronous resolutions */
+extern struct latency_hist dns_cache_lookup_hist;
+
+#endif /* DNS_CACHE_H */
@@ -0,0 +1,82 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+
+#include "weather_station.h"
+
+/**
+ * @brief Sample journal counters.
+ */
+struct journal_stats {
+    uint32_t appended; /**< Samples written to flash */
+    uint32_t replayed; /**< Samples uploaded from flash */
+    uint32_t dropped;  /**< Samples lost when the oldest sector was reclaimed */
+    uint32_t erases;   /**< Sectors erased */
+    uint32_t pending;  /**< Samples waiting to be replayed */
+};
+
+/**
+ * @brief Mount the journal on the storage flash partition.
+ *
+ * Samples left over from before a reset are counted as pending and will be replayed,
+ * from the last replay position recorded in flash, so samples delivered before the reset
+ * are not sent again. The boot number is one more than the one stored with the newest
+ * entry, and is recorded for the next boot.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+int journal_init(void);
+
+/**
+ * @brief Get the number of this boot, counted by journal_init().
+ *
+ * Uptimes restart at every boot, so samples replayed after a reset are told apart from
+ * this boot's by their boot number. The count starts again from 0 if the journal is
+ * formatted.
+ */
+uint16_t journal_boot(void);
+
+/**
+ * @brief Append a sample that could not be delivered.
+ *
+ * Records are written sequentially; when the partition is full the oldest sector is
+ * erased and reused, dropping its samples.
+ *
+ * @param sample The sample to store.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+int journal_append(const struct ws_sample *sample);
+
+/**
+ * @brief Upload stored samples, oldest first.
+ *
+ * Sends up to CONFIG_WEATHER_STATION_JOURNAL_REPLAY_BURST bulk requests of at most
+ * CONFIG_UPLINK_BULK_MAX_SAMPLES samples each, all from the same boot, so the caller is not
+ * held up for long. Full sectors are erased once all their samples have been delivered;
+ * the sector being written is never erased early, and the replay position recorded in
+ * flash after each call skips its delivered samples instead.
+ *
+ * @return int Returns the number of samples uploaded, or a negative error code if an
+ *         upload failed (samples already uploaded are still accounted for).
+ */
+int journal_replay(void);
+
+/**
+ * @brief Get the number of samples waiting to be replayed.
+ */
+uint32_t journal_pending(void);
+
+/**
+ * @brief Get a snapshot of the journal counters.
+ *
+ * @param out Destination for the counters.
+ */
+void journal_get_stats(struct journal_stats *out);
+
+#endif /* JOURNAL_H */
@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#include <stdint.h>
+
+/*
+ * Buckets are powers of two microseconds: bucket 0 holds 0 us, bucket b holds
+ * [2^(b-1), 2^b) us, and the last bucket also holds everything from
+ * LATENCY_HIST_OVERFLOW_US (about 4 s) up.
+ */
+#define LATENCY_HIST_BUCKETS     24
+#define LATENCY_HIST_OVERFLOW_US BIT(LATENCY_HIST_BUCKETS - 2)
+
+/**
+ * @brief Latency histogram.
+ *
+ * Recording is one atomic increment, without locks, so it is cheap enough to leave enabled
+ * and safe from any context. Readers take the buckets one at a time, so a snapshot taken
+ * while values are recorded may be off by those values.
+ */
+struct latency_hist {
+    atomic_t buckets[LATENCY_HIST_BUCKETS];
+};
+
+/**
+ * @brief Record a latency.
+ *
+ * @param hist The histogram.
+ * @param us   Latency in microseconds.
+ */
+static inline void latency_hist_record(struct latency_hist *hist, uint32_t us)
+{
+    uint32_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+
+    atomic_inc(&hist->buckets[MIN(bucket, LATENCY_HIST_BUCKETS - 1)]);
+}
+
+/**
+ * @brief Record the time since @p start.
+ *
+ * @param hist  The histogram.
+ * @param start k_cycle_get_32() when the timed operation started.
+ */
+static inline void latency_hist_record_cycles(struct latency_hist *hist, uint32_t start)
+{
+    latency_hist_record(hist, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+}
+
+/**
+ * @brief Number of latencies recorded.
+ */
+uint32_t latency_hist_count(const struct latency_hist *hist);
+
+/**
+ * @brief Estimate a percentile.
+ *
+ * @param hist The histogram.
+ * @param pct  Percentile, 1 to 100.
+ *
+ * @return The exclusive upper bound in microseconds of the bucket holding the percentile,
+ *         0 if nothing was recorded, or UINT32_MAX if it is in the overflow bucket.
+ */
+uint32_t latency_hist_percentile(const struct latency_hist *hist, uint32_t pct);
+
+/**
+ * @brief Empty the histogram.
+ */
+void latency_hist_reset(struct latency_hist *hist);
+
+#endif /* LATENCY_HIST_H */
@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef LOG_DEDUP_H
+#define LOG_DEDUP_H
+
+#include <zephyr/logging/log.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Repeats of the last failure within this time are counted instead of logged */
+#define LOG_DEDUP_MS (60 * MSEC_PER_SEC)
+
+/**
+ * @brief Failure log state of a module.
+ *
+ * While the network is down every sample fails the same way. The first failure is logged;
+ * repeats of it are only counted, and the count is logged with the next different failure,
+ * after a success, or at most every LOG_DEDUP_MS. Each module keeps its own state and logs
+ * with LOG_DEDUP_FAILURE() and LOG_DEDUP_SUCCESS(), so the messages carry its name.
+ */
+struct log_dedup {
+    const char *op;    /**< Failed operation, NULL after a success */
+    int err;           /**< Its negative error code */
+    uint32_t repeats;  /**< Repeats not logged yet */
+    int64_t logged_ms; /**< Uptime when it was last logged */
+};
+
+/**
+ * @brief Count a failure, for LOG_DEDUP_FAILURE().
+ *
+ * @param dedup The module's state.
+ * @param op    Name of the failed operation, a string literal.
+ * @param err   Negative error code.
+ * @param prev  Set to the previous state if the failure is to be logged, so that its unlogged
+ *              repeats can be.
+ *
+ * @return true if the failure is to be logged now.
+ */
+bool log_dedup_failure(struct log_dedup *dedup, const char *op, int err,
+                       struct log_dedup *prev);
+
+/**
+ * @brief End a run of failures, for LOG_DEDUP_SUCCESS().
+ *
+ * @param dedup The module's state.
+ * @param prev  Set to the previous state if a run of failures ended.
+ *
+ * @return true if a run of failures ended, so the recovery is to be logged.
+ */
+bool log_dedup_success(struct log_dedup *dedup, struct log_dedup *prev);
+
+/* Unlogged repeats of the failure that @p prev ended */
+#define LOG_DEDUP_REPEATS_(prev)                                                      \
+    do {                                                                              \
+        if ((prev).repeats > 0) {                                                     \
+            LOG_WRN("op=%s err=%d repeated=%u", (prev).op, (prev).err, (prev).repeats); \
+        }                                                                             \
+    } while (0)
+
+/**
+ * @brief Log a failed operation in the calling module, folding repeats.
+ *
+ * @param dedup The module's struct log_dedup.
+ * @param op    Name of the failed operation, a string literal.
+ * @param err   Negative error code.
+ */
+#define LOG_DEDUP_FAILURE(dedup, op, err)                                             \
+    do {                                                                              \
+        struct log_dedup prev_;                                                       \
+        if (log_dedup_failure((dedup), (op), (err), &prev_)) {                        \
+            LOG_DEDUP_REPEATS_(prev_);                                                \
+            LOG_ERR("op=%s err=%d", (op), (err));                                     \
+        }                                                                             \
+    } while (0)
+
+/**
+ * @brief Note a success in the calling module, ending any run of failures.
+ *
+ * @param dedup The module's struct log_dedup.
+ */
+#define LOG_DEDUP_SUCCESS(dedup)                                                      \
+    do {                                                                              \
+        struct log_dedup prev_;                                                       \
+        if (log_dedup_success((dedup), &prev_)) {                                     \
+            LOG_DEDUP_REPEATS_(prev_);                                                \
+            LOG_INF("op=%s recovered", prev_.op);                                     \
+        }                                                                             \
+    } while (0)
+
+#endif /* LOG_DEDUP_H */
@@ -0,0 +1,61 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+
+#include "latency_hist.h"
+#include "weather_station.h"
+
+/**
+ * @brief Sampling/uplink pipeline counters.
+ */
+struct pipeline_stats {
+    uint32_t produced;    /**< Samples taken by the sampling thread */
+    uint32_t consumed;    /**< Samples handed to the uplink */
+    uint32_t dropped;     /**< Oldest samples discarded because the queue was full */
+    uint32_t depth;       /**< Samples currently queued */
+    uint32_t high_water;  /**< Largest queue depth seen */
+    uint32_t max_late_us; /**< Worst delay of a sample behind its scheduled time */
+    uint32_t sampler_wakeups; /**< Times the sampling thread woke up */
+    uint32_t uplink_wakeups;  /**< Times the uplink thread woke up */
+    uint32_t radio_sessions;  /**< Times the radio was brought up (duty cycling) */
+    uint32_t radio_failures;  /**< Radio sessions that failed to connect */
+    uint32_t radio_on_ms;     /**< Total time the radio was up for a session */
+    uint32_t delivered;         /**< Samples sent by the uplink, alone or in a batch */
+    uint32_t delivery_last_ms;  /**< Time from taking the last delivered sample to its send */
+    uint32_t delivery_max_ms;   /**< Longest time from taking a sample to its send */
+    uint64_t delivery_total_ms; /**< Sum of delivery times, for the mean */
+    uint32_t sampler_stack_unused; /**< Sampling thread stack never used, with CONFIG_INIT_STACKS */
+    uint32_t uplink_stack_unused;  /**< Uplink thread stack never used, with CONFIG_INIT_STACKS */
+};
+
+/**
+ * @brief Start the sampling and uplink threads.
+ *
+ * The sampling thread reads every station every CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS on
+ * absolute deadlines and queues the samples; the uplink thread drains the queue and sends them,
+ * so network stalls never delay sampling. When the queue is full the oldest sample is dropped.
+ *
+ * @param stations Ready sparkfun,weather-meter-kit sensor devices to sample; index i is
+ *                 station i of the wind statistics.
+ * @param count    Number of stations.
+ */
+void pipeline_start(const struct device *const *stations, size_t count);
+
+/**
+ * @brief Get a snapshot of the pipeline counters.
+ *
+ * @param out Destination for the counters.
+ */
+void pipeline_get_stats(struct pipeline_stats *out);
+
+/* Time the uplink thread spends logging a sample, see CONFIG_WEATHER_STATION_TRACE_INTERVAL_MS */
+extern struct latency_hist pipeline_trace_hist;
+
+#endif /* PIPELINE_H */
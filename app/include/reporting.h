@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef REPORTING_H
+#define REPORTING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "weather_station.h"
+
+/**
+ * @brief Adaptive reporting thresholds.
+ *
+ * Changes are measured from the last sample sent for the station. Defaults come from the
+ * CONFIG_WEATHER_STATION_REPORT_* options.
+ */
+struct reporting_params {
+    uint32_t speed_deadband;     /**< Speed change in 0.01 kph worth sending */
+    uint32_t direction_deadband; /**< Direction change in 0.1 degrees worth sending */
+    uint32_t gust;               /**< Speed rise in 0.01 kph sent at once; 0 for none */
+    uint32_t shift;              /**< Direction change in 0.1 degrees sent at once; 0 for none */
+    uint32_t heartbeat_ms;       /**< Longest time between samples sent for a station */
+};
+
+/**
+ * @brief Adaptive reporting counters.
+ *
+ * Every sample checked is either suppressed or sent for exactly one reason.
+ */
+struct reporting_stats {
+    uint32_t samples;    /**< Samples checked */
+    uint32_t suppressed; /**< Samples within the deadbands, not sent */
+    uint32_t changes;    /**< Sent: outside a deadband, or the first from the station */
+    uint32_t gusts;      /**< Sent at once: speed rise of at least the gust threshold */
+    uint32_t shifts;     /**< Sent at once: direction change of at least the shift threshold */
+    uint32_t heartbeats; /**< Sent: nothing sent for the heartbeat interval */
+};
+
+/**
+ * @brief What to do with a sample.
+ */
+enum reporting_decision {
+    REPORTING_SUPPRESS, /**< Drop it: nothing worth sending changed */
+    REPORTING_SEND,     /**< Queue it as usual */
+    REPORTING_SEND_NOW, /**< Queue it and send the queue without waiting */
+};
+
+/**
+ * @brief Decide whether to send a sample.
+ *
+ * Called by the sampling thread for each sample, in order.
+ *
+ * @param station Index of the station that took the sample, below WS_NUM_STATIONS.
+ * @param sample  The sample.
+ *
+ * @return The decision, which is also counted in the reporting counters.
+ */
+enum reporting_decision reporting_check(size_t station, const struct ws_sample *sample);
+
+/**
+ * @brief Get the current thresholds.
+ *
+ * @param out Destination for the thresholds.
+ */
+void reporting_get_params(struct reporting_params *out);
+
+/**
+ * @brief Change the thresholds; they apply from the next sample.
+ *
+ * @param params New thresholds.
+ *
+ * @return int Returns 0 on success, or -EINVAL if a direction is over 180 degrees or the
+ *         heartbeat interval is 0.
+ */
+int reporting_set_params(const struct reporting_params *params);
+
+/**
+ * @brief Get a snapshot of the reporting counters.
+ *
+ * @param out Destination for the counters.
+ */
+void reporting_get_stats(struct reporting_stats *out);
+
+#endif /* REPORTING_H */
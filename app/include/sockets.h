@@ -3,16 +3,53 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
- 
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "weather_station.h"
+#include "uplink.h"
+
 /**
  * @brief Sends an HTTP GET request with dynamic URL parameters.
  *
- * Constructs a URL using the given wind speed and wind direction, resolves the server address,
- * establishes a connection (with TLS if enabled), sends the HTTP GET request, and then closes the connection.
+ * Constructs a URL using the given station, wind speed and wind direction and sends the HTTP
+ * GET request over a persistent keep-alive connection, which is (re)established (with TLS if
+ * enabled) on first use or after the server has closed it.
  *
- * @param wind_speed    The measured wind speed.
- * @param wind_direction The measured wind direction.
+ * @param station       The id of the station that took the measurement.
+ * @param wind_speed    The measured wind speed in 0.01 kph.
+ * @param wind_direction The measured wind direction in 0.1 degrees, negative if unknown.
  *
  * @return int Returns 0 on success or a negative error code on failure.
  */
-int http_get_dynamic(float wind_speed, float wind_direction);
\ No newline at end of file
+int http_get_dynamic(uint16_t station, uint32_t wind_speed, int32_t wind_direction);
+
+/**
+ * @brief Upload several samples in a single HTTP POST.
+ *
+ * The samples are sent as CSV records ("station,boot,uptime_ms,speed,direction"), one per
+ * line, to CONFIG_HTTP_POST_PATH over the persistent keep-alive connection, so one request
+ * can carry samples from several stations.
+ *
+ * @param samples Samples to send, oldest first.
+ * @param count   Number of samples, at most CONFIG_UPLINK_BULK_MAX_SAMPLES.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+int http_post_samples(const struct ws_sample *samples, size_t count);
+
+#if defined(CONFIG_UPLINK_BINARY)
+/**
+ * @brief Send samples as one compact binary frame over UDP.
+ *
+ * The frame format is described in wire.h; one frame can carry samples from several
+ * stations. Delivery is not acknowledged, so only local send errors are reported.
+ *
+ * @param samples Samples to send, oldest first.
+ * @param count   Number of samples, at most CONFIG_UPLINK_BULK_MAX_SAMPLES.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+int udp_send_samples(const struct ws_sample *samples, size_t count);
+#endif
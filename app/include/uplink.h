@@ -0,0 +1,186 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef UPLINK_H
+#define UPLINK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "latency_hist.h"
+#include "weather_station.h"
+
+/**
+ * @brief Uplink session counters.
+ *
+ * Latencies cover the whole request, including any (re)connect it triggered.
+ */
+struct uplink_stats {
+    uint32_t requests;   /**< Requests sent successfully */
+    uint32_t samples;    /**< Samples carried by successful requests */
+    uint32_t failures;   /**< Requests that could not be sent */
+    uint32_t connects;   /**< Connections established */
+    uint32_t reconnects; /**< Connections dropped by EOF/RST and re-established */
+    uint32_t last_us;    /**< Latency of the most recent request */
+    uint32_t min_us;     /**< Lowest request latency */
+    uint32_t max_us;     /**< Highest request latency */
+    uint64_t total_us;   /**< Sum of request latencies, for the mean */
+    uint32_t connect_last_us;  /**< Time to connect, including any TLS handshake */
+    uint32_t connect_max_us;   /**< Longest connect */
+    uint64_t connect_total_us; /**< Sum of connect times, for the mean */
+    uint32_t bytes_sent;       /**< Request bytes handed to the socket */
+    uint32_t bytes_formatted;  /**< Request bytes formatted into buffers; the rest are constant */
+};
+
+/**
+ * @brief An uplink transport.
+ *
+ * Each transport carries samples to the server in its own protocol; CONFIG_UPLINK_HTTP,
+ * CONFIG_UPLINK_BINARY, CONFIG_UPLINK_MQTT or CONFIG_UPLINK_COAP selects the one in use.
+ * Transports connect on first use and reconnect after the connection is lost, and are only
+ * called from one thread at a time.
+ */
+struct uplink_transport {
+    /** Name for log messages */
+    const char *name;
+    /** Prepare the transport at startup; may be NULL */
+    int (*init)(void);
+    /** Send a sample as soon as it is taken */
+    int (*send)(const struct ws_sample *sample);
+    /** Send up to CONFIG_UPLINK_BULK_MAX_SAMPLES timestamped samples at once */
+    int (*send_samples)(const struct ws_sample *samples, size_t count);
+    /** Close the connection; the next send reconnects */
+    void (*close)(void);
+};
+
+extern const struct uplink_transport http_transport;
+extern const struct uplink_transport udp_transport;
+extern const struct uplink_transport mqtt_transport;
+extern const struct uplink_transport coap_transport;
+
+/**
+ * @brief Prepare the configured transport.
+ *
+ * Call it once at startup, for example to register TLS credentials.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+int uplink_init(void);
+
+/**
+ * @brief Send a sample over the configured transport as soon as it is taken.
+ *
+ * @param sample The sample to send.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+int uplink_send(const struct ws_sample *sample);
+
+/**
+ * @brief Send samples in bulk over the configured transport.
+ *
+ * Unlike uplink_send(), the samples keep their timestamps, so this also carries samples
+ * replayed from the journal.
+ *
+ * @param samples Samples to send, oldest first, all taken in the same boot.
+ * @param count   Number of samples, at most CONFIG_UPLINK_BULK_MAX_SAMPLES.
+ *
+ * @return int Returns 0 on success, -EINVAL if the samples are from different boots, or
+ *         a negative error code on failure.
+ */
+int uplink_send_samples(const struct ws_sample *samples, size_t count);
+
+/**
+ * @brief Close the uplink connection.
+ *
+ * Used before the network goes down, so the next request reconnects instead of finding
+ * out that the old connection is dead.
+ */
+void uplink_close(void);
+
+/**
+ * @brief Get a snapshot of the uplink session counters.
+ *
+ * @param out Destination for the counters.
+ */
+void uplink_get_stats(struct uplink_stats *out);
+
+/**
+ * @brief Record a new connection in the uplink counters, for transports.
+ *
+ * @param start Uptime in ticks when the connection was started.
+ */
+void uplink_record_connect(int64_t start);
+
+/**
+ * @brief Record a completed request in the uplink counters, for transports.
+ *
+ * @param start   Uptime in ticks when the request was started.
+ * @param samples Number of samples carried by the request.
+ */
+void uplink_record_request(int64_t start, uint32_t samples);
+
+/* Counters updated directly by the transports, see uplink_get_stats() */
+extern struct uplink_stats uplink_stats;
+
+/* Connect and request latencies, recorded with the counters */
+extern struct latency_hist uplink_connect_hist;
+extern struct latency_hist uplink_request_hist;
+
+#if defined(CONFIG_UPLINK_BATCH)
+/**
+ * @brief Callback for the samples of a batched upload once it has been sent.
+ *
+ * @param samples Samples sent, oldest first.
+ * @param count   Number of samples.
+ */
+typedef void (*uplink_batch_sent_t)(const struct ws_sample *samples, size_t count);
+
+/**
+ * @brief Set the callback for sent batches.
+ *
+ * @param sent Called from uplink_batch_add() or uplink_batch_flush() after each successful
+ *             upload; NULL for none.
+ */
+void uplink_batch_set_callback(uplink_batch_sent_t sent);
+
+/**
+ * @brief Queue a sample for the next batched upload.
+ *
+ * Queued samples are sent with uplink_send_samples() once CONFIG_UPLINK_BATCH_MAX_SAMPLES are
+ * queued or the oldest queued sample is older than CONFIG_UPLINK_BATCH_MAX_LINGER_MS. If that
+ * upload fails the samples stay queued and it is retried with the next sample or a linger
+ * period later. The caller sends a batch that falls due between samples, see
+ * uplink_batch_due().
+ *
+ * @param sample The sample to queue.
+ *
+ * @return int Returns 0 if the sample was queued, or -EAGAIN if the queue is full and still
+ *         could not be uploaded, in which case the caller keeps the sample.
+ */
+int uplink_batch_add(const struct ws_sample *sample);
+
+/**
+ * @brief Upload all queued samples now.
+ *
+ * The queue is only emptied if the upload succeeds; otherwise it falls due again a linger
+ * period later.
+ *
+ * @return int Returns 0 on success (or if nothing was queued), or a negative error code.
+ */
+int uplink_batch_flush(void);
+
+/**
+ * @brief Get the time the queued samples are to be sent by.
+ *
+ * That is when the oldest queued sample has lingered for CONFIG_UPLINK_BATCH_MAX_LINGER_MS,
+ * or when a failed upload is to be retried. The caller waiting for the next sample wakes
+ * up then to call uplink_batch_flush().
+ *
+ * @return int64_t Returns the uptime in milliseconds, or -1 if nothing is queued.
+ */
+int64_t uplink_batch_due(void);
+#endif
+
+#endif /* UPLINK_H */
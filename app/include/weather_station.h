@@ -8,10 +8,14 @@
 #ifndef SFE_WEATHER_METER_KIT_H
 #define SFE_WEATHER_METER_KIT_H
 
+#include <zephyr/devicetree.h>
 #include <zephyr/drivers/adc.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/sys/atomic.h>
 #include <stdint.h>
 
+#include "latency_hist.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -42,13 +46,59 @@ extern "C" {
 #define WMK_ANGLE_337_5                15
 
 #define SFE_WMK_ADC_RESOLUTION         10   // Example: 10-bit ADC resolution
-#define SFE_WIND_VANE_DEGREES_PER_INDEX 22.5f
+#define SFE_WIND_VANE_DECIDEGREES_PER_INDEX 225  // 22.5 degrees per vane position
+#define SFE_WMK_ADC_GAIN               ADC_GAIN_1_4  // Vane gain without a DT channel node
+
+/*
+ * Wind vane decode table: one entry per bucket of ADC codes, at most
+ * 2^SFE_WMK_VANE_LUT_BITS buckets whatever the ADC resolution. A reading
+ * matches a vane position if it is within SFE_WMK_VANE_TOLERANCE counts
+ * (at SFE_WMK_ADC_RESOLUTION) of its calibration value.
+ */
+#define SFE_WMK_VANE_LUT_BITS          10
+#define SFE_WMK_VANE_LUT_SIZE          (1 << SFE_WMK_VANE_LUT_BITS)
+#define SFE_WMK_VANE_TOLERANCE         10
+#define SFE_WMK_VANE_INVALID           0xFF
+
+/*
+ * Anemometer edge timestamps kept for window accounting and pulse-period
+ * estimation. Must be a power of two and cover the edges of at least one
+ * measurement period (256 edges in 1 s is about 300 kph).
+ */
+#define SFE_WMK_PULSE_RING_SIZE        256
+
+/*
+ * Pulse-period estimation: with no edge for this long the wind speed is
+ * reported as zero (2.4 kph per closure per second gives about 0.4 kph).
+ */
+#define SFE_WMK_PERIOD_TIMEOUT_MS      3000
+
+/* Number of sparkfun,weather-meter-kit stations enabled in the devicetree */
+#define WS_NUM_STATIONS DT_NUM_INST_STATUS_OKAY(sparkfun_weather_meter_kit)
+
+/*
+ * printk helpers for fixed-point readings: speed in 0.01 kph as "12.34",
+ * direction in 0.1 degrees as "337.5" ("-1.0" when unknown).
+ */
+#define WS_SPEED_FMT          "%u.%02u"
+#define WS_SPEED_ARGS(v)      (unsigned int)((v) / 100), (unsigned int)((v) % 100)
+#define WS_DIRECTION_FMT      "%d.%u"
+#define WS_DIRECTION_ARGS(v)  (int)((v) < 0 ? -1 : (v) / 10), (unsigned int)((v) < 0 ? 0 : (v) % 10)
 
 /*----------------------------------------------------------------------------
  * Data Structures
  *----------------------------------------------------------------------------
  */
 
+/**
+ * @brief Wind speed estimation methods.
+ */
+typedef enum {
+    SFE_WMK_SPEED_WINDOW = 0, /**< Count edges in fixed measurement windows */
+    SFE_WMK_SPEED_PERIOD_AVG, /**< Moving average of the last N switch closure periods */
+    SFE_WMK_SPEED_PERIOD_EMA, /**< Exponential moving average of closure periods, alpha = 2^-N */
+} SFEWeatherMeterKitSpeedMode;
+
 /**
  * @brief Calibration parameters for wind measurements.
  *
@@ -66,14 +116,29 @@ typedef struct {
  *
  * Holds calibration parameters, measurement counters, timing information,
  * and device/pin configuration for wind speed and wind direction.
+ *
+ * The anemometer interrupt only writes pulseStamps/pulseCycles and increments
+ * pulseHead; every other field is owned by the thread that reads the kit.
  */
 typedef struct {
     SFEWeatherMeterKitCalibrationParams calibrationParams;
+    atomic_t pulseHead;                    /**< Edges counted since boot (ISR) */
+    uint32_t pulseStamps[SFE_WMK_PULSE_RING_SIZE]; /**< Uptime (ms) of recent edges (ISR) */
+    uint32_t pulseCycles[SFE_WMK_PULSE_RING_SIZE]; /**< Cycle count of recent edges (ISR) */
+    uint32_t windowStartCount;             /**< pulseHead at the start of the current window */
     uint32_t windCountsPrevious;
-    uint32_t windCounts;
     uint32_t lastWindSpeedMillis;
+    SFEWeatherMeterKitSpeedMode speedMode; /**< Estimator used by getWindSpeed */
+    uint8_t  speedFilterParam;             /**< N for the period filters */
+    uint32_t periodLastIndex;              /**< Last edge folded into periodEma */
+    uint64_t periodEma;                    /**< Filtered closure period, cycles << 4 */
+    uint32_t centiKphPerCountPerSec;       /**< kphPerCountPerSec in 0.01 kph, for integer math */
+    uint8_t  adcResolutionBits;            /**< Resolution of readings and vaneADCValues */
+    uint8_t  vaneLUTShift;                 /**< ADC code to vaneLUT bucket shift */
+    uint8_t  vaneLUT[SFE_WMK_VANE_LUT_SIZE]; /**< Vane index per bucket, or SFE_WMK_VANE_INVALID */
     const struct device *adc_dev;          /**< ADC device for wind direction sensor */
     int                   wind_dir_adc_channel; /**< ADC channel for wind direction */
+    enum adc_gain         wind_dir_adc_gain; /**< Gain the wind direction channel is set up with */
     const struct device *gpio_dev;         /**< GPIO device for wind speed sensor */
     int                   wind_speed_pin;   /**< GPIO pin for wind speed sensor */
     struct gpio_callback  wind_speed_cb;    /**< GPIO callback structure */
@@ -124,6 +189,9 @@ SFEWeatherMeterKitCalibrationParams SFEWeatherMeterKit_getCalibrationParams(SFEW
 /**
  * @brief Set new calibration parameters.
  *
+ * The vane ADC values are taken to be at the kit's current ADC resolution.
+ * Rebuilds the wind vane decode table.
+ *
  * @param kit Pointer to a SFEWeatherMeterKit structure.
  * @param params New calibration parameters.
  */
@@ -131,38 +199,93 @@ void SFEWeatherMeterKit_setCalibrationParams(SFEWeatherMeterKit *kit,
                                              SFEWeatherMeterKitCalibrationParams params);
 
 /**
- * @brief Adjust the ADC resolution of the calibration values.
+ * @brief Set the ADC resolution used for wind direction readings.
+ *
+ * Rescales the calibration values from the current resolution and rebuilds the
+ * wind vane decode table.
  *
  * @param kit Pointer to a SFEWeatherMeterKit structure.
  * @param resolutionBits The desired ADC resolution (in bits).
  */
 void SFEWeatherMeterKit_setADCResolutionBits(SFEWeatherMeterKit *kit, uint8_t resolutionBits);
 
+/**
+ * @brief Decode a raw wind vane ADC reading.
+ *
+ * Constant-time lookup in the table built from the calibration values.
+ *
+ * @param kit Pointer to a SFEWeatherMeterKit structure.
+ * @param rawADC ADC reading at the kit's resolution.
+ * @return Vane position index (0 to WMK_NUM_ANGLES - 1), or -ERANGE if the
+ *         reading matches no calibrated position.
+ */
+int SFEWeatherMeterKit_decodeVaneIndex(const SFEWeatherMeterKit *kit, int32_t rawADC);
+
+/**
+ * @brief Get the wind direction in tenths of a degree.
+ *
+ * Reads the ADC value from the wind vane and decodes it to the closest
+ * calibrated direction.
+ *
+ * @param kit Pointer to a SFEWeatherMeterKit structure.
+ * @return Wind direction in 0.1 degrees, or a negative error code if the ADC
+ *         read failed or the reading matches no vane position (-ERANGE).
+ */
+int32_t SFEWeatherMeterKit_getWindDirectionDeciDegrees(SFEWeatherMeterKit *kit);
+
 /**
  * @brief Get the wind direction in degrees.
  *
- * Reads the ADC value from the wind vane, compares it to calibration values,
- * and returns the closest matching direction.
+ * Floating-point wrapper for SFEWeatherMeterKit_getWindDirectionDeciDegrees().
  *
  * @param kit Pointer to a SFEWeatherMeterKit structure.
- * @return Wind direction in degrees.
+ * @return Wind direction in degrees, or -1 if it could not be determined.
  */
 float SFEWeatherMeterKit_getWindDirection(SFEWeatherMeterKit *kit);
 
+/**
+ * @brief Get the measured wind speed in hundredths of a kilometer per hour.
+ *
+ * Uses the method selected with SFEWeatherMeterKit_setWindSpeedMode() (by default,
+ * the counts recorded during the last measurement window), with integer arithmetic only.
+ *
+ * @param kit Pointer to a SFEWeatherMeterKit structure.
+ * @return Wind speed in 0.01 kph.
+ */
+uint32_t SFEWeatherMeterKit_getWindSpeedCentiKph(SFEWeatherMeterKit *kit);
+
 /**
  * @brief Get the measured wind speed in kilometers per hour.
  *
- * Computes wind speed based on the counts recorded during the last measurement window.
+ * Floating-point wrapper for SFEWeatherMeterKit_getWindSpeedCentiKph().
  *
  * @param kit Pointer to a SFEWeatherMeterKit structure.
  * @return Wind speed in kph.
  */
 float SFEWeatherMeterKit_getWindSpeed(SFEWeatherMeterKit *kit);
 
+/**
+ * @brief Select the wind speed estimation method.
+ *
+ * The period estimators time each switch closure (two edges) with the hardware
+ * cycle counter and give a fresh reading whenever they are queried, instead of
+ * one per measurement window. The ISR work is the same for every method.
+ *
+ * @param kit Pointer to a SFEWeatherMeterKit structure.
+ * @param mode Estimation method.
+ * @param filterParam Closures averaged (SFE_WMK_SPEED_PERIOD_AVG, 1 to
+ *        SFE_WMK_PULSE_RING_SIZE / 2 - 1) or EMA shift (SFE_WMK_SPEED_PERIOD_EMA,
+ *        0 to 15); ignored for SFE_WMK_SPEED_WINDOW.
+ * @return 0 on success, -EINVAL if the mode or parameter is out of range.
+ */
+int SFEWeatherMeterKit_setWindSpeedMode(SFEWeatherMeterKit *kit,
+                                        SFEWeatherMeterKitSpeedMode mode,
+                                        uint8_t filterParam);
+
 /**
  * @brief Get the number of wind speed counts.
  *
- * Returns the current count of wind speed pulses in the current measurement window.
+ * Returns the number of wind speed pulses so far in the current measurement window.
  *
  * @param kit Pointer to a SFEWeatherMeterKit structure.
  * @return Wind speed counts.
@@ -185,20 +308,56 @@ void SFEWeatherMeterKit_resetWindSpeedFilter(SFEWeatherMeterKit *kit);
  */
  typedef struct {
     SFEWeatherMeterKit kit;
+    uint16_t station_id;   /**< Station id reported with the samples */
 } WeatherStation;
 
+/**
+ * @brief Hardware of one weather station, from a sparkfun,weather-meter-kit node.
+ */
+struct weather_station_config {
+    struct adc_dt_spec vane;        /**< Wind vane ADC channel */
+    struct gpio_dt_spec anemometer; /**< Anemometer reed switch input */
+    uint16_t station_id;            /**< Station id reported with the samples */
+};
+
+/**
+ * @brief Initializer for a struct weather_station_config from a devicetree node.
+ *
+ * @param node_id A sparkfun,weather-meter-kit node.
+ */
+#define WEATHER_STATION_CONFIG_DT(node_id)                                     \
+    {                                                                          \
+        .vane       = ADC_DT_SPEC_GET(node_id),                                \
+        .anemometer = GPIO_DT_SPEC_GET(node_id, anemometer_gpios),             \
+        .station_id = DT_PROP(node_id, station_id),                            \
+    }
+
+/**
+ * @brief A timestamped wind reading.
+ *
+ * Uptimes restart at every boot, so a sample is timed by its boot number and its uptime
+ * together; samples kept in the journal across a reset keep the boot they were taken in.
+ */
+struct ws_sample {
+    int64_t timestamp;     /**< Uptime in milliseconds when the sample was taken */
+    uint16_t wind_speed;    /**< Wind speed in 0.01 kph */
+    int16_t  wind_direction; /**< Wind direction in 0.1 degrees, negative if unknown */
+    uint16_t station;       /**< Id of the station that took the sample */
+    uint16_t boot;          /**< Boot number when the sample was taken */
+};
+
 /**
  * @brief Initialize the weather station.
  *
+ * Each station keeps its own context, so any number can be initialised; the anemometer
+ * interrupt finds its station from the GPIO callback. The sparkfun,weather-meter-kit sensor
+ * driver (wmk_sensor.h) calls this for each devicetree node.
+ *
  * @param ws Pointer to the WeatherStation instance.
- * @param adc_dev ADC device pointer.
- * @param gpio_dev GPIO device pointer.
- * @param gpio_pin The GPIO pin number used.
+ * @param config Station hardware, usually from WEATHER_STATION_CONFIG_DT().
+ * @return 0 on success, negative error code on failure.
  */
-void weather_station_init(WeatherStation *ws,
-                          const struct device *adc_dev,
-                          const struct device *gpio_dev,
-                          uint32_t gpio_pin);
+int weather_station_init(WeatherStation *ws, const struct weather_station_config *config);
 
 /**
  * @brief Get the current wind speed.
@@ -216,6 +375,35 @@ float weather_station_get_wind_speed(WeatherStation *ws);
  */
 float weather_station_get_wind_direction(WeatherStation *ws);
 
+/**
+ * @brief Take a timestamped wind speed and direction reading.
+ *
+ * With CONFIG_WEATHER_STATION_VANE_OVERSAMPLING the direction is the vector
+ * mean of the oversampled vane readings since the previous call.
+ *
+ * @param ws Pointer to the WeatherStation instance.
+ * @param sample Destination for the reading.
+ */
+void weather_station_read(WeatherStation *ws, struct ws_sample *sample);
+
+/**
+ * @brief Set the boot number stamped on samples from now on.
+ *
+ * The journal keeps the boot number across resets (journal_init()); without it every boot
+ * is boot 0.
+ *
+ * @param boot Number of this boot.
+ */
+void weather_station_set_boot(uint16_t boot);
+
+/**
+ * @brief Get the boot number stamped on samples.
+ */
+uint16_t weather_station_boot(void);
+
+/* Duration of single vane ADC reads, from all stations */
+extern struct latency_hist weather_station_adc_hist;
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,15 +4,76 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#ifndef WIFI_H
+#define WIFI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+/**
+ * @brief WiFi connection manager counters.
+ */
+struct wifi_stats {
+    uint32_t attempts;   /**< Connect requests sent */
+    uint32_t connects;   /**< Connections established */
+    uint32_t failures;   /**< Attempts that failed or timed out */
+    uint32_t lost;       /**< Connections dropped while wanted */
+    uint32_t backoff_ms; /**< Backoff before the most recent retry */
+};
+
 #if defined(CONFIG_WIFI)
 /**
- * @brief Connect to a WiFi network.
+ * @brief Start connecting to the WiFi network, without waiting.
+ *
+ * Uses the SSID and PSK defined in the build configuration. A state machine on the system
+ * workqueue connects in the background and, until wifi_down(), reconnects whenever the
+ * connection is lost, backing off exponentially with random jitter between failed attempts.
+ */
+void wifi_start(void);
+
+/**
+ * @brief Bring the WiFi connection up, if it is not already.
+ *
+ * Calls wifi_start() and waits for the connection.
+ *
+ * @param timeout How long to wait for the connection.
+ * @return int Returns 0 once connected, or -ETIMEDOUT. Connecting carries on in the
+ *         background after a timeout.
+ */
+int wifi_up(k_timeout_t timeout);
+
+/**
+ * @brief Disconnect from the WiFi network, letting the radio idle.
+ *
+ * Stops reconnecting until the next wifi_start() or wifi_up(). The disconnect itself
+ * happens in the background.
+ *
+ * @return int Returns 0.
+ */
+int wifi_down(void);
+
+/**
+ * @brief Enable or disable WiFi power save mode on the connected network.
+ *
+ * @param enable true to let the radio sleep between beacons.
+ * @return int Returns 0 on success, or a negative error code.
+ */
+int wifi_power_save(bool enable);
+
+/**
+ * @brief Get a snapshot of the connection manager counters.
  *
- * Initiates a connection to a WiFi network using the configuration parameters (SSID and PSK)
- * defined in the build configuration.
+ * @param out Destination for the counters.
  */
-void wifi_connect(void);
+void wifi_get_stats(struct wifi_stats *out);
 
 #else
-#define wifi_connect()
-#endif
\ No newline at end of file
+static inline void wifi_start(void) { }
+static inline int wifi_up(k_timeout_t timeout) { return 0; }
+static inline int wifi_down(void) { return 0; }
+static inline int wifi_power_save(bool enable) { return 0; }
+static inline void wifi_get_stats(struct wifi_stats *out) { *out = (struct wifi_stats){ 0 }; }
+#endif
+
+#endif /* WIFI_H */
@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef WIND_MATH_H
+#define WIND_MATH_H
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------------------
+ * Fixed-point helpers for wind direction statistics
+ *----------------------------------------------------------------------------
+ * Angles are compass bearings in tenths of a degree (0 = north, clockwise).
+ * Sines and cosines are Q15 (32767 = 1.0).
+ */
+#define WM_Q15_ONE 32767
+
+/**
+ * @brief Cosine of a bearing.
+ *
+ * @param ddeg Bearing in 0.1 degrees (any value, wrapped to one turn).
+ * @return cos(ddeg) in Q15, interpolated from a 1-degree table.
+ */
+int16_t wm_cos_q15(int32_t ddeg);
+
+/**
+ * @brief Sine of a bearing.
+ *
+ * @param ddeg Bearing in 0.1 degrees (any value, wrapped to one turn).
+ * @return sin(ddeg) in Q15.
+ */
+int16_t wm_sin_q15(int32_t ddeg);
+
+/**
+ * @brief Bearing of a vector.
+ *
+ * @param east  East (sine) component.
+ * @param north North (cosine) component.
+ * @return Bearing in 0.1 degrees (0 to 3599, within about 0.3 degrees), or -1
+ *         for the zero vector.
+ */
+int32_t wm_atan2_ddeg(int64_t east, int64_t north);
+
+/**
+ * @brief Angle between two bearings.
+ *
+ * @param a Bearing in 0.1 degrees (any value, wrapped to one turn).
+ * @param b Bearing in 0.1 degrees (any value, wrapped to one turn).
+ * @return The smaller angle between them in 0.1 degrees, 0 to 1800.
+ */
+int32_t wm_angle_diff_ddeg(int32_t a, int32_t b);
+
+/**
+ * @brief Integer square root.
+ *
+ * @return floor(sqrt(value)).
+ */
+uint32_t wm_isqrt(uint64_t value);
+
+#endif /* WIND_MATH_H */
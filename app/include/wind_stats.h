@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef WIND_STATS_H
+#define WIND_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "weather_station.h"
+
+/* Averaging periods, as used for WMO wind reports */
+#define WIND_STATS_GUST_MS  3000
+#define WIND_STATS_SHORT_MS (2 * 60 * 1000)
+#define WIND_STATS_LONG_MS  (10 * 60 * 1000)
+
+/**
+ * @brief Wind statistics over one averaging period.
+ *
+ * Speeds are in 0.01 kph and directions in 0.1 degrees, like struct ws_sample. Until the
+ * station has run for a whole period the statistics cover the samples taken so far.
+ */
+struct wind_stats_window {
+    uint16_t samples;          /**< Samples in the period */
+    uint16_t mean;             /**< Scalar mean speed */
+    uint16_t min;              /**< Lowest sample */
+    uint16_t max;              /**< Highest sample */
+    uint16_t gust;             /**< Highest 3 second mean speed */
+    uint16_t vector_speed;     /**< Magnitude of the mean wind vector */
+    int16_t  vector_direction; /**< Direction of the mean wind vector, -1 if calm */
+    int16_t  direction;        /**< Unit vector mean direction, -1 if unknown */
+    int16_t  direction_sd;     /**< Yamartino direction standard deviation, -1 if unknown */
+};
+
+/**
+ * @brief Rolling wind statistics.
+ */
+struct wind_stats_report {
+    int64_t timestamp;               /**< Timestamp of the latest sample */
+    uint16_t gust;                   /**< Current 3 second mean speed */
+    struct wind_stats_window short_term; /**< Last 2 minutes */
+    struct wind_stats_window long_term;  /**< Last 10 minutes */
+};
+
+/**
+ * @brief Add a sample to the rolling statistics.
+ *
+ * Each station has its own statistics. Samples are expected every
+ * CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS; the averaging periods are counted in samples.
+ * Running sums and monotonic min/max queues keep the cost constant per sample, whatever
+ * the period lengths.
+ *
+ * @param station Station index, below WS_NUM_STATIONS.
+ * @param sample Sample to add. A negative direction counts towards the speed statistics only.
+ * @return 0 on success, -EINVAL if @p station is out of range.
+ */
+int wind_stats_add(size_t station, const struct ws_sample *sample);
+
+/**
+ * @brief Get a station's current statistics.
+ *
+ * @param station Station index, below WS_NUM_STATIONS.
+ * @param out Destination for the report.
+ * @return 0 on success, -EINVAL if @p station is out of range.
+ */
+int wind_stats_get(size_t station, struct wind_stats_report *out);
+
+#endif /* WIND_STATS_H */
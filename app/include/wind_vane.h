@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef WIND_VANE_H
+#define WIND_VANE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "weather_station.h"
+
+/**
+ * @brief Wind direction statistics over one reporting period.
+ */
+struct wind_vane_report {
+    int16_t  mean;     /**< Vector mean direction in 0.1 degrees, -1 if no valid samples */
+    uint16_t variance; /**< Circular variance (1 - mean resultant length) in 1/1000 */
+    uint16_t samples;  /**< Valid samples in the period */
+    uint16_t invalid;  /**< Samples that matched no vane position */
+};
+
+/**
+ * @brief Oversampled acquisition counters.
+ */
+struct wind_vane_stats {
+    uint32_t samples;  /**< Samples decoded */
+    uint32_t invalid;  /**< Samples that matched no vane position */
+    uint32_t errors;   /**< Failed ADC reads */
+    bool     paced;    /**< Using timer-paced single reads instead of ADC sequences */
+};
+
+/**
+ * @brief Start oversampled wind vane acquisition for a kit.
+ *
+ * A thread at a lower priority than the sampling and uplink threads samples the vanes at
+ * CONFIG_WEATHER_STATION_VANE_RATE_HZ. It reads blocks of CONFIG_WEATHER_STATION_VANE_BLOCK
+ * samples with one repeated-sampling ADC sequence, or with timer-paced single reads if the
+ * ADC driver does not support sequence intervals, taking each kit in turn. Each block is
+ * decoded in one pass into the kit's per-position histogram.
+ *
+ * @param kit Initialised kit whose ADC channel and calibration are used.
+ * @return 0 on success, -ENOMEM if WS_NUM_STATIONS kits are already sampled.
+ */
+int wind_vane_start(SFEWeatherMeterKit *kit);
+
+/**
+ * @brief Take a kit's statistics for the period since the previous call.
+ *
+ * @param kit Kit passed to wind_vane_start().
+ * @param out Destination for the report.
+ */
+void wind_vane_take_report(const SFEWeatherMeterKit *kit, struct wind_vane_report *out);
+
+/**
+ * @brief Get a snapshot of the acquisition counters.
+ *
+ * @param out Destination for the counters.
+ */
+void wind_vane_get_stats(struct wind_vane_stats *out);
+
+#endif /* WIND_VANE_H */
@@ -0,0 +1,129 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+
+#include "weather_station.h"
+
+/*----------------------------------------------------------------------------
+ * Compact binary sample frame
+ *----------------------------------------------------------------------------
+ * All multi-byte fields are little-endian.
+ *
+ *   u8   magic      WIRE_MAGIC
+ *   u8   version    WIRE_VERSION
+ *   u16  station    station id of the first sample
+ *   u16  boot       boot number of all the samples (ws_sample.boot)
+ *   u32  base       uptime (ms, truncated) of the first sample
+ *   u8   count      number of records
+ *   count x record:
+ *     varint dsta   zigzag-encoded change of station id from the previous
+ *                   sample (from the header for the first), so a frame can
+ *                   carry several stations' samples at a byte per record
+ *     varint dt     ms since the previous sample (0 for the first)
+ *     u16    speed  wind speed in 0.01 kph
+ *     u16    dir    wind direction in 0.1 degrees, WIRE_DIR_INVALID if unknown
+ *   u16  crc        crc16_ccitt() with seed 0xffff (CRC-16/MCRF4XX) of everything
+ *                   before it
+ *
+ * tools/ws_wire_decode.py decodes these frames on the server side.
+ */
+#define WIRE_MAGIC        0x57
+#define WIRE_VERSION      4
+#define WIRE_HEADER_SIZE  11
+#define WIRE_CRC_SIZE     2
+#define WIRE_RECORD_MAX   12   /* 3-byte and 5-byte varints + speed + direction */
+#define WIRE_MAX_RECORDS  255
+#define WIRE_DIR_INVALID  0xffff
+
+/** Worst-case size of a frame carrying @p n records */
+#define WIRE_FRAME_SIZE(n) (WIRE_HEADER_SIZE + (n) * WIRE_RECORD_MAX + WIRE_CRC_SIZE)
+
+/*----------------------------------------------------------------------------
+ * Packed sample frame
+ *----------------------------------------------------------------------------
+ * Same header and CRC as above, with version WIRE_VERSION_PACKED and count
+ * the number of samples rather than records. Each record describes what
+ * changed since the previous sample of the same station in the frame, and
+ * may stand for up to 8 samples:
+ *
+ *   u8     tag      bit 0: dsta follows
+ *                   bit 1: ddt follows
+ *                   bit 2: dspeed follows
+ *                   bits 3-4: direction, WIRE_PACKED_DIR_*
+ *                   bits 5-7: repeat, the number of further samples that
+ *                   follow the same interval with the same values
+ *   varint dsta     zigzag change of station id from the previous record
+ *                   (from the header for the first)
+ *   varint ddt      zigzag change of the interval between the station's
+ *                   samples
+ *   varint dspeed   zigzag change of speed in 0.01 kph
+ *   varint ddir     zigzag change of direction, the shorter way round the
+ *                   circle, in 0.1 degrees or in vane sectors
+ *
+ * Absent fields are unchanged. The first time a station appears in a frame
+ * its state starts from the time of the previous sample (the header base for
+ * the first), an interval of 0, a speed of 0 and an unknown direction; a
+ * change from an unknown direction is a change from 0. State is kept for the
+ * last WIRE_PACKED_STATIONS stations to appear, so a further station takes
+ * the slot of the one that appeared earliest.
+ *
+ * A steady wind sampled at a steady rate packs 8 samples into a byte, and a
+ * slowly changing one takes 2 to 3 bytes per sample rather than 6 or more.
+ */
+#define WIRE_VERSION_PACKED        5
+#define WIRE_PACKED_STATION        BIT(0)
+#define WIRE_PACKED_DT             BIT(1)
+#define WIRE_PACKED_SPEED          BIT(2)
+#define WIRE_PACKED_DIR_SHIFT      3
+#define WIRE_PACKED_DIR_SAME       0   /* no ddir */
+#define WIRE_PACKED_DIR_SECTORS    1   /* ddir in WIRE_PACKED_SECTOR steps */
+#define WIRE_PACKED_DIR_DELTA      2   /* ddir in 0.1 degrees */
+#define WIRE_PACKED_DIR_UNKNOWN    3   /* no ddir, direction now unknown */
+#define WIRE_PACKED_REPEAT_SHIFT   5
+#define WIRE_PACKED_REPEAT_MAX     7
+#define WIRE_PACKED_SECTOR         225 /* 22.5 degrees, one of the vane's 16 positions */
+#define WIRE_PACKED_STATIONS       8
+#define WIRE_PACKED_RECORD_MAX     14  /* tag, 3 + 5 + 3 + 2 byte varints */
+
+/** Worst-case size of a packed frame carrying @p n samples */
+#define WIRE_PACKED_FRAME_SIZE(n) \
+    (WIRE_HEADER_SIZE + (n) * WIRE_PACKED_RECORD_MAX + WIRE_CRC_SIZE)
+
+/**
+ * @brief Encode samples into a binary frame.
+ *
+ * @param buf        Destination buffer.
+ * @param size       Size of @p buf; WIRE_FRAME_SIZE(count) is always enough.
+ * @param samples    Samples to encode, from any stations but one boot, oldest first.
+ * @param count      Number of samples, at most WIRE_MAX_RECORDS.
+ *
+ * @return int Returns the frame length, -ENOMEM if it does not fit in @p buf, or -EINVAL
+ *         if the samples are from different boots or out of order.
+ */
+int wire_encode(uint8_t *buf, size_t size, const struct ws_sample *samples, size_t count);
+
+/**
+ * @brief Encode samples into a packed frame.
+ *
+ * Samples are encoded as they are read, with a few bytes of state per station, so the RAM
+ * needed does not grow with the number of samples.
+ *
+ * @param buf        Destination buffer.
+ * @param size       Size of @p buf; WIRE_PACKED_FRAME_SIZE(count) is always enough.
+ * @param samples    Samples to encode, from any stations but one boot, oldest first.
+ * @param count      Number of samples, at most WIRE_MAX_RECORDS.
+ *
+ * @return int Returns the frame length, -ENOMEM if it does not fit in @p buf, or -EINVAL
+ *         if the samples are from different boots or out of order.
+ */
+int wire_encode_packed(uint8_t *buf, size_t size, const struct ws_sample *samples,
+                       size_t count);
+
+#endif /* WIRE_H */
@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef WMK_SENSOR_H
+#define WMK_SENSOR_H
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+
+#include "weather_station.h"
+
+/**
+ * @brief Sensor channels of the sparkfun,weather-meter-kit driver.
+ *
+ * Zephyr has no standard wind channels, so the driver uses private ones. Values are in the
+ * kit's units rather than SI ones.
+ */
+enum wmk_sensor_channel {
+    /** Wind speed in km/h */
+    SENSOR_CHAN_WMK_WIND_SPEED = SENSOR_CHAN_PRIV_START,
+    /** Wind direction in degrees clockwise from north; not available when unknown */
+    SENSOR_CHAN_WMK_WIND_DIRECTION,
+};
+
+/**
+ * @brief Take a timestamped reading from a weather meter kit.
+ *
+ * The fixed-point reading behind sensor_sample_fetch(), also used by the sampling pipeline.
+ * Readings from different threads are serialised by the driver.
+ *
+ * @param dev    A sparkfun,weather-meter-kit device.
+ * @param sample Destination for the reading, including the node's station-id.
+ * @return 0 on success, or a negative error code.
+ */
+int wmk_sensor_read(const struct device *dev, struct ws_sample *sample);
+
+/**
+ * @brief Get the weather station behind a weather meter kit device.
+ *
+ * For diagnostics such as the emulator benchmark, which drive the kit directly. The
+ * caller must not read the kit while the device is being sampled.
+ *
+ * @param dev A sparkfun,weather-meter-kit device.
+ * @return The device's weather station.
+ */
+WeatherStation *wmk_sensor_station(const struct device *dev);
+
+#endif /* WMK_SENSOR_H */
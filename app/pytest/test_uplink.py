@@ -0,0 +1,254 @@
+# SPDX-License-Identifier: Apache-2.0
+"""Uplink scenarios: the native_sim build against the stand-in servers in tools/.
+
+Run by twister (harness: pytest) for the sample.weather_station.uplink.* scenarios
+in sample.yaml. Each stand-in is started before the device and checks what the
+device sends; the test then checks the decoded samples.
+"""
+
+import re
+import sys
+import time
+from pathlib import Path
+
+import pytest
+from twister_harness import DeviceAdapter
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[2] / "tools"))
+
+import ws_coap_server  # noqa: E402
+import ws_http_sink  # noqa: E402
+import ws_mqtt_broker  # noqa: E402
+import ws_wire_decode  # noqa: E402
+
+BENCH_UPLINK = r"Bench uplink: .*, (\d+) failed"
+
+
+def kconfig(dut: DeviceAdapter):
+    """Return the build's CONFIG_* values as strings, without the CONFIG_ prefix."""
+    values = {}
+    path = Path(dut.device_config.build_dir) / "zephyr" / ".config"
+    for line in path.read_text().splitlines():
+        match = re.match(r"CONFIG_(\w+)=(.*)", line)
+        if match:
+            values[match.group(1)] = match.group(2).strip('"')
+    return values
+
+
+def wait_for(condition, timeout):
+    deadline = time.monotonic() + timeout
+    while not condition():
+        if time.monotonic() > deadline:
+            return False
+        time.sleep(0.1)
+    return True
+
+
+def bench_uplink(dut: DeviceAdapter):
+    """Wait for the bench uplink run and check that no request failed."""
+    lines = dut.readlines_until(regex=BENCH_UPLINK, timeout=60)
+    failed = re.search(BENCH_UPLINK, lines[-1])
+    assert failed, "no bench uplink run: %s" % lines[-1]
+    assert failed.group(1) == "0", lines[-1]
+
+
+def check_sequence(batches, period_ms):
+    """Check that consecutive batches carry evenly spaced, increasing uptimes of one boot."""
+    assert len({sample[1] for batch in batches for sample in batch}) <= 1, "several boots"
+    timestamps = [sample[2] for batch in batches for sample in batch]
+    steps = [b - a for a, b in zip(timestamps, timestamps[1:])]
+    assert steps, "fewer than two samples"
+    for step in steps:
+        assert abs(step - period_ms) <= period_ms // 10, \
+            "uptimes %s not %d ms apart" % (timestamps, period_ms)
+
+
+@pytest.fixture(scope="session")
+def http_sink():
+    # The native_sim build sends to 127.0.0.1:8080 (boards/native_sim.conf)
+    server = ws_http_sink.serve(8080)
+    yield ws_http_sink.SinkHandler
+    server.shutdown()
+
+
+@pytest.fixture(scope="session")
+def wire_receiver():
+    # Binary frames go to the HTTP host on CONFIG_UPLINK_BINARY_PORT, default 4011
+    server = ws_wire_decode.serve(4011)
+    yield ws_wire_decode.Receiver
+    server.shutdown()
+
+
+@pytest.fixture(scope="session")
+def mqtt_broker():
+    # The scenario points CONFIG_UPLINK_MQTT_BROKER at 127.0.0.1, default port and prefix
+    server = ws_mqtt_broker.serve(1883)
+    yield ws_mqtt_broker.Broker
+    server.shutdown()
+
+
+@pytest.fixture(scope="session")
+def coap_server():
+    # The scenario points CONFIG_UPLINK_COAP_SERVER at 127.0.0.1, default port and path
+    server = ws_coap_server.serve(5683)
+    yield ws_coap_server.CoapServer
+    server.shutdown()
+
+
+def test_http_batch(http_sink, dut: DeviceAdapter):
+    config = kconfig(dut)
+    period_ms = int(config["WEATHER_STATION_SAMPLE_PERIOD_MS"])
+    batch_size = int(config["UPLINK_BATCH_MAX_SAMPLES"])
+    http_sink.max_samples = int(config["UPLINK_BULK_MAX_SAMPLES"])
+
+    bench_uplink(dut)
+    with http_sink.lock:
+        bench = list(http_sink.batches)
+    # Every bench bulk upload is one full POST of evenly spaced samples
+    assert bench, "no bulk POST from the bench"
+    for batch in bench:
+        assert len(batch) == http_sink.max_samples
+        check_sequence([batch], period_ms)
+
+    # Then the pipeline sends full batches as the samples come in
+    assert wait_for(lambda: len(http_sink.batches) >= len(bench) + 3,
+                    timeout=5 * batch_size * period_ms / 1000), "no batches from the pipeline"
+    with http_sink.lock:
+        batches = http_sink.batches[len(bench):]
+        versions = list(http_sink.versions)
+    assert not http_sink.errors, http_sink.errors
+    for batch in batches:
+        assert len(batch) == batch_size, "batch of %d samples" % len(batch)
+        assert {sample[0] for sample in batch} == {bench[0][0][0]}
+    check_sequence(batches, period_ms)
+
+    # Packed frames (uplink.http_packed) or CSV, decoded by the sink either way
+    expected = ws_wire_decode.WIRE_VERSION_PACKED if config.get("UPLINK_PACKED") == "y" else None
+    assert set(versions) == {expected}, "frame versions %s" % set(versions)
+
+
+def test_http_adaptive(http_sink, dut: DeviceAdapter):
+    config = kconfig(dut)
+    heartbeat_ms = int(config["WEATHER_STATION_REPORT_HEARTBEAT_MS"])
+    linger_ms = int(config["UPLINK_BATCH_MAX_LINGER_MS"])
+    http_sink.max_samples = int(config["UPLINK_BULK_MAX_SAMPLES"])
+    assert linger_ms < heartbeat_ms
+
+    bench_uplink(dut)
+    with http_sink.lock:
+        bench = len(http_sink.batches)
+
+    # The bench leaves a steady wind inside the deadbands, so only heartbeats are sent.
+    # Each one falls due a linger period after it is queued, before the next heartbeat
+    # could carry it, so every batch holds a single sample.
+    assert wait_for(lambda: len(http_sink.batches) >= bench + 4,
+                    timeout=6 * heartbeat_ms / 1000), "no batches from the pipeline"
+    with http_sink.lock:
+        batches = http_sink.batches[bench:]
+    assert not http_sink.errors, http_sink.errors
+    for batch in batches:
+        assert len(batch) == 1, "batch of %d samples" % len(batch)
+    # The first sample is sent as a change, the rest one heartbeat apart
+    check_sequence(batches[1:], heartbeat_ms)
+
+
+def test_binary(wire_receiver, dut: DeviceAdapter):
+    config = kconfig(dut)
+    period_ms = int(config["WEATHER_STATION_SAMPLE_PERIOD_MS"])
+    bulk_size = int(config["UPLINK_BULK_MAX_SAMPLES"])
+
+    bench_uplink(dut)
+    with wire_receiver.lock:
+        bench = list(wire_receiver.frames)
+    # The bench sends its own samples: 12 kph from 45 degrees, in evenly spaced bulk frames
+    bulk = [samples for samples in bench if len(samples) > 1]
+    assert bulk, "no bulk frame from the bench"
+    for samples in bulk:
+        assert len(samples) == bulk_size
+        check_sequence([samples], period_ms)
+    for samples in bench:
+        for sample in samples:
+            assert sample[3:] == (12.0, 45.0), "bench sample %s" % (sample,)
+
+    # Then the pipeline sends each sample in its own frame, as it is taken, of the steady
+    # 5 Hz (12 kph) wind from 45 degrees the bench leaves running
+    assert wait_for(lambda: len(wire_receiver.frames) >= len(bench) + 5,
+                    timeout=10 * period_ms / 1000), "no frames from the pipeline"
+    with wire_receiver.lock:
+        live = wire_receiver.frames[len(bench):]
+    # Every datagram passed its CRC and decoded whole
+    assert not wire_receiver.errors, wire_receiver.errors
+    for samples in live:
+        assert len(samples) == 1
+        assert samples[0][4] == 45.0, "direction %s" % (samples[0][4],)
+    check_sequence(live, period_ms)
+    # Once the speed filter has filled
+    for samples in live[-3:]:
+        assert abs(samples[0][3] - 12.0) <= 1.2, "speed %s" % (samples[0][3],)
+
+
+def test_mqtt(mqtt_broker, dut: DeviceAdapter):
+    config = kconfig(dut)
+    period_ms = int(config["WEATHER_STATION_SAMPLE_PERIOD_MS"])
+    bulk_size = int(config["UPLINK_BULK_MAX_SAMPLES"])
+
+    bench_uplink(dut)
+    with mqtt_broker.lock:
+        bench = [samples for _, samples in mqtt_broker.messages]
+    # Every bench bulk upload is one message of evenly spaced samples
+    bulk = [samples for samples in bench if len(samples) > 1]
+    assert bulk, "no bulk publish from the bench"
+    for samples in bulk:
+        assert len(samples) == bulk_size
+        check_sequence([samples], period_ms)
+
+    # Then the pipeline publishes each sample as it is taken
+    assert wait_for(lambda: len(mqtt_broker.messages) >= len(bench) + 3,
+                    timeout=10 * period_ms / 1000), "no publishes from the pipeline"
+    with mqtt_broker.lock:
+        live = [samples for _, samples in mqtt_broker.messages[len(bench):]]
+        connects = list(mqtt_broker.connects)
+    assert not mqtt_broker.errors, mqtt_broker.errors
+    for samples in live:
+        assert len(samples) == 1
+    check_sequence(live, period_ms)
+
+    # All over one persistent session, created by the first connection
+    assert connects, "no CONNECT"
+    for client_id, clean, _ in connects:
+        assert client_id == config["UPLINK_MQTT_CLIENT_ID"]
+        assert not clean, "clean session requested"
+    assert not connects[0][2]
+
+
+def test_coap(coap_server, dut: DeviceAdapter):
+    config = kconfig(dut)
+    period_ms = int(config["WEATHER_STATION_SAMPLE_PERIOD_MS"])
+    bulk_size = int(config["UPLINK_BULK_MAX_SAMPLES"])
+    assert config.get("UPLINK_COAP_CONFIRMABLE") == "y"
+
+    bench_uplink(dut)
+    with coap_server.lock:
+        bench = list(coap_server.uploads)
+    # Every bench bulk upload is confirmable and sent block-wise, and comes back whole
+    bulk = [(blocks, samples) for msg_type, blocks, samples in bench
+            if msg_type == ws_coap_server.TYPE_CON]
+    assert bulk, "no confirmable upload from the bench"
+    for blocks, samples in bulk:
+        assert blocks > 1, "bulk upload in one block"
+        assert len(samples) == bulk_size
+        check_sequence([samples], period_ms)
+    # Live samples are single non-confirmable messages
+    for msg_type, blocks, samples in bench:
+        if msg_type == ws_coap_server.TYPE_NON:
+            assert blocks == 1 and len(samples) == 1
+
+    # Then the pipeline sends each sample as it is taken
+    assert wait_for(lambda: len(coap_server.uploads) >= len(bench) + 3,
+                    timeout=10 * period_ms / 1000), "no messages from the pipeline"
+    with coap_server.lock:
+        live = coap_server.uploads[len(bench):]
+    assert not coap_server.errors, coap_server.errors
+    for msg_type, blocks, samples in live:
+        assert msg_type == ws_coap_server.TYPE_NON and len(samples) == 1
+    check_sequence([samples for _, _, samples in live], period_ms)
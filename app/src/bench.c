@@ -0,0 +1,306 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+
+#include "bench.h"
+#include "uplink.h"
+#include "wmk_sensor.h"
+
+/* Edges timed for the interrupt cost */
+#define BENCH_EDGES 1000
+
+/* Vane decodes timed, spread over all ADC codes */
+#define BENCH_DECODES 1024
+
+/* Requests of each kind timed for the uplink throughput */
+#define BENCH_REQUESTS 50
+
+/* Interval between speed readings while a pulse train settles, as the sampler would read */
+#define BENCH_POLL_MS 50
+
+/* Steady wind left running for the pipeline */
+#define BENCH_WIND_HZ   5
+#define BENCH_WIND_VANE WMK_ANGLE_45_0
+
+/* Anemometer closure rates swept (Hz); rates above CONFIG_WEATHER_STATION_BENCH_MAX_HZ are
+ * skipped */
+static const uint16_t sweep_hz[] = { 1, 5, 20, 50, 100, 200, 400, 1000 };
+
+#if defined(CONFIG_BOARD_NATIVE_SIM)
+/* Host monotonic clock (ns) from bench_host.c: simulated time stands still while code runs */
+uint64_t bench_host_ns(void);
+
+static inline uint32_t bench_clock(void)
+{
+    return (uint32_t)bench_host_ns();
+}
+
+static inline uint32_t bench_ns(uint32_t delta)
+{
+    return delta;
+}
+#else
+static inline uint32_t bench_clock(void)
+{
+    return k_cycle_get_32();
+}
+
+static inline uint32_t bench_ns(uint32_t delta)
+{
+    return (uint32_t)k_cyc_to_ns_floor64(delta);
+}
+#endif
+
+/*----------------------------------------------------------------------------
+ * Anemometer pulse trains
+ *----------------------------------------------------------------------------
+ * A timer toggles the emulated anemometer input, two edges per switch
+ * closure. The emulator runs the kit's callback in the timer's interrupt
+ * context, as the GPIO interrupt would.
+ */
+static struct {
+    const struct device *port;
+    gpio_pin_t pin;
+    int level;
+} pulse;
+
+static void pulse_edge(struct k_timer *timer)
+{
+    pulse.level = !pulse.level;
+    gpio_emul_input_set(pulse.port, pulse.pin, pulse.level);
+}
+
+static K_TIMER_DEFINE(pulse_timer, pulse_edge, NULL);
+
+/**
+ * @brief Start a pulse train of about @p hz switch closures per second.
+ */
+static void pulse_start(uint32_t hz)
+{
+    uint32_t ticks = MAX(1, k_us_to_ticks_near32(USEC_PER_SEC / 2 / hz));
+
+    k_timer_start(&pulse_timer, K_TICKS(ticks), K_TICKS(ticks));
+}
+
+/*----------------------------------------------------------------------------
+ * Interrupt cost
+ *----------------------------------------------------------------------------
+ * Toggles the anemometer input, then a neighbouring pin without a callback,
+ * from thread context. The difference is the cost of the kit's callback.
+ */
+static int bench_isr(SFEWeatherMeterKit *kit)
+{
+    const struct device *port = kit->gpio_dev;
+    gpio_pin_t pin = kit->wind_speed_pin;
+    gpio_pin_t ref = pin > 0 ? pin - 1 : pin + 1;
+    uint32_t start, with_cb, without_cb;
+    int ret;
+
+    ret = gpio_pin_configure(port, ref, GPIO_INPUT);
+    if (ret < 0) {
+        printk("Bench: reference pin %u unavailable (%d)\n", ref, ret);
+        return ret;
+    }
+
+    gpio_emul_input_set(port, ref, 0);
+    start = bench_clock();
+    for (int i = 0; i < BENCH_EDGES; i++) {
+        gpio_emul_input_set(port, ref, (i + 1) & 1);
+    }
+    without_cb = bench_clock() - start;
+
+    gpio_emul_input_set(port, pin, 0);
+    start = bench_clock();
+    for (int i = 0; i < BENCH_EDGES; i++) {
+        gpio_emul_input_set(port, pin, (i + 1) & 1);
+    }
+    with_cb = bench_clock() - start;
+
+    printk("Bench ISR: %u ns per edge (%u ns with the emulator)\n",
+           bench_ns(with_cb > without_cb ? with_cb - without_cb : 0) / BENCH_EDGES,
+           bench_ns(with_cb) / BENCH_EDGES);
+    return 0;
+}
+
+/*----------------------------------------------------------------------------
+ * Wind speed sweep
+ *----------------------------------------------------------------------------
+ * Runs each pulse train for two measurement windows, reading the speed as
+ * the sampler would, and times the last reading. The speeds themselves are
+ * checked by tests/weather_station.
+ */
+static void bench_speed(SFEWeatherMeterKit *kit)
+{
+    uint32_t settle_ms = 2 * kit->calibrationParams.windSpeedMeasurementPeriodMillis +
+                         BENCH_POLL_MS;
+
+    for (size_t i = 0; i < ARRAY_SIZE(sweep_hz); i++) {
+        if (sweep_hz[i] > CONFIG_WEATHER_STATION_BENCH_MAX_HZ) {
+            break;
+        }
+
+        SFEWeatherMeterKit_resetWindSpeedFilter(kit);
+        pulse_start(sweep_hz[i]);
+        for (uint32_t t = 0; t < settle_ms; t += BENCH_POLL_MS) {
+            k_msleep(BENCH_POLL_MS);
+            (void)SFEWeatherMeterKit_getWindSpeedCentiKph(kit);
+        }
+
+        uint32_t start = bench_clock();
+        uint32_t speed = SFEWeatherMeterKit_getWindSpeedCentiKph(kit);
+        uint32_t read_ns = bench_ns(bench_clock() - start);
+        k_timer_stop(&pulse_timer);
+
+        printk("Bench speed %u Hz: " WS_SPEED_FMT " kph, read %u ns\n", sweep_hz[i],
+               WS_SPEED_ARGS(speed), read_ns);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Wind direction sweep
+ *----------------------------------------------------------------------------
+ * Sets the emulated vane voltage to each position's calibration value and
+ * times the read and decode, then the decode alone over all codes. The
+ * decoded directions are checked by tests/weather_station.
+ */
+static int vane_set(SFEWeatherMeterKit *kit, int index)
+{
+    /* The middle of the calibration value's code, so the emulator converts it back exactly */
+    int32_t mv = 2 * kit->calibrationParams.vaneADCValues[index] + 1;
+
+    adc_raw_to_millivolts(adc_ref_internal(kit->adc_dev), kit->wind_dir_adc_gain,
+                          kit->adcResolutionBits + 1, &mv);
+    return adc_emul_const_value_set(kit->adc_dev, kit->wind_dir_adc_channel, mv);
+}
+
+static int bench_vane(SFEWeatherMeterKit *kit)
+{
+    uint32_t read_ns = 0;
+    volatile int sink;
+    int ret;
+
+    for (int i = 0; i < WMK_NUM_ANGLES; i++) {
+        ret = vane_set(kit, i);
+        if (ret < 0) {
+            printk("Bench: could not set the vane voltage (%d)\n", ret);
+            return ret;
+        }
+
+        uint32_t start = bench_clock();
+        sink = SFEWeatherMeterKit_getWindDirectionDeciDegrees(kit);
+        read_ns += bench_ns(bench_clock() - start);
+    }
+
+    uint32_t start = bench_clock();
+    for (int32_t i = 0; i < BENCH_DECODES; i++) {
+        sink = SFEWeatherMeterKit_decodeVaneIndex(kit, (i << kit->adcResolutionBits) /
+                                                        BENCH_DECODES);
+    }
+    uint32_t decode_ns = bench_ns(bench_clock() - start);
+    (void)sink;
+
+    printk("Bench vane: read and decode %u ns, decode %u ns\n", read_ns / WMK_NUM_ANGLES,
+           decode_ns / BENCH_DECODES);
+    return 0;
+}
+
+/*----------------------------------------------------------------------------
+ * Uplink throughput
+ *----------------------------------------------------------------------------
+ * Sends live and bulk requests back to back over the configured transport,
+ * after one request to connect. Skipped if the server is not reachable.
+ */
+static struct ws_sample bench_samples[CONFIG_UPLINK_BULK_MAX_SAMPLES];
+
+static void bench_uplink(uint16_t station)
+{
+    struct uplink_stats before, bulk, after;
+    int64_t now = k_uptime_get();
+    uint32_t start, live_ns, bulk_ns;
+
+    for (size_t i = 0; i < ARRAY_SIZE(bench_samples); i++) {
+        bench_samples[i] = (struct ws_sample){
+            .timestamp = now - (int64_t)(ARRAY_SIZE(bench_samples) - i) *
+                               CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS,
+            .station = station,
+            .boot = weather_station_boot(),
+            .wind_speed = 1200,
+            .wind_direction = 450,
+        };
+    }
+
+    if (uplink_send(&bench_samples[0]) < 0) {
+        printk("Bench uplink: server unreachable, skipped\n");
+        return;
+    }
+    uplink_get_stats(&before);
+
+    start = bench_clock();
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        (void)uplink_send(&bench_samples[i % ARRAY_SIZE(bench_samples)]);
+    }
+    live_ns = MAX(1, bench_ns(bench_clock() - start));
+    uplink_get_stats(&bulk);
+
+    start = bench_clock();
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        (void)uplink_send_samples(bench_samples, ARRAY_SIZE(bench_samples));
+    }
+    bulk_ns = MAX(1, bench_ns(bench_clock() - start));
+    uplink_get_stats(&after);
+
+    /* Formatted bytes of a bulk upload are its body, which is what packing shrinks */
+    uint32_t bulk_bytes_x10 = (after.bytes_formatted - bulk.bytes_formatted) * 10 /
+                              (BENCH_REQUESTS * ARRAY_SIZE(bench_samples));
+
+    printk("Bench uplink: live %u requests/s, bulk %u requests/s (%u samples/s,"
+           " %u.%u bytes/sample), %u failed\n",
+           (uint32_t)((uint64_t)BENCH_REQUESTS * NSEC_PER_SEC / live_ns),
+           (uint32_t)((uint64_t)BENCH_REQUESTS * NSEC_PER_SEC / bulk_ns),
+           (uint32_t)((uint64_t)BENCH_REQUESTS * ARRAY_SIZE(bench_samples) * NSEC_PER_SEC /
+                      bulk_ns),
+           bulk_bytes_x10 / 10, bulk_bytes_x10 % 10,
+           after.failures - before.failures);
+}
+
+int bench_run(const struct device *station)
+{
+    WeatherStation *ws = wmk_sensor_station(station);
+    SFEWeatherMeterKit *kit = &ws->kit;
+    int ret;
+
+    pulse.port = kit->gpio_dev;
+    pulse.pin = kit->wind_speed_pin;
+
+    printk("Bench: station %u on %s pin %d, %s channel %d (%u bits)\n", ws->station_id,
+           kit->gpio_dev->name, kit->wind_speed_pin, kit->adc_dev->name,
+           kit->wind_dir_adc_channel, kit->adcResolutionBits);
+
+    ret = bench_isr(kit);
+    if (ret < 0) {
+        return ret;
+    }
+    bench_speed(kit);
+    ret = bench_vane(kit);
+    if (ret < 0) {
+        return ret;
+    }
+    bench_uplink(ws->station_id);
+
+    printk("Bench: done\n");
+
+    /* Leave a steady wind for the pipeline */
+    SFEWeatherMeterKit_resetWindSpeedFilter(kit);
+    (void)vane_set(kit, BENCH_WIND_VANE);
+    pulse_start(BENCH_WIND_HZ);
+    return 0;
+}
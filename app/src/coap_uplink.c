@@ -0,0 +1,405 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/coap.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+
+#include "dns_cache.h"
+#include "log_dedup.h"
+#include "uplink.h"
+
+LOG_MODULE_REGISTER(uplink_coap, CONFIG_WEATHER_STATION_LOG_LEVEL);
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_UPLINK_COAP_BLOCK_SIZE),
+             "the CoAP block size must be a power of two");
+
+/* Block size as a Block1 SZX exponent */
+#define COAP_BLOCK_SZX ((enum coap_block_size)(LOG2(CONFIG_UPLINK_COAP_BLOCK_SIZE) - 4))
+
+/* Longest CSV record: "<station>,<boot>,<uptime ms>,<speed>,<direction>\n" */
+#define COAP_RECORD_MAX 62
+
+BUILD_ASSERT(COAP_RECORD_MAX <= CONFIG_UPLINK_COAP_BLOCK_SIZE,
+             "a CoAP block must hold at least one record");
+
+/* Header, token and options: Uri-Path, Content-Format and Block1 */
+#define COAP_OVERHEAD_MAX (4 + COAP_TOKEN_MAX_LEN + sizeof(CONFIG_UPLINK_COAP_PATH) + 16)
+
+/* Connected datagram socket to the server */
+static int coap_sock = -1;
+
+/* Message being sent, and the response being parsed */
+static uint8_t msg_buf[COAP_OVERHEAD_MAX + CONFIG_UPLINK_COAP_BLOCK_SIZE];
+static uint8_t rsp_buf[COAP_OVERHEAD_MAX + 64];
+
+/* Payload of the upload being sent, as CSV records */
+static char payload_buf[CONFIG_UPLINK_BULK_MAX_SAMPLES * COAP_RECORD_MAX];
+
+/* Failures of the exchanges with the server, logged with repeats folded */
+static struct log_dedup failures;
+
+/**
+ * @brief Open the datagram socket to the CoAP server.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int coap_open(void)
+{
+    struct sockaddr_in addr;
+    int ret;
+    int sock;
+
+    ret = dns_cache_lookup(CONFIG_UPLINK_COAP_SERVER, STRINGIFY(CONFIG_UPLINK_COAP_PORT), &addr);
+    if (ret < 0) {
+        return ret;
+    }
+    addr.sin_port = htons(CONFIG_UPLINK_COAP_PORT);
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ret = -errno;
+        LOG_DEDUP_FAILURE(&failures, "socket", ret);
+        return ret;
+    }
+
+    int64_t start = k_uptime_ticks();
+    ret = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+    if (ret < 0) {
+        ret = -errno;
+        LOG_DEDUP_FAILURE(&failures, "connect", ret);
+        close(sock);
+        return ret;
+    }
+
+    coap_sock = sock;
+    uplink_record_connect(start);
+    return 0;
+}
+
+/**
+ * @brief Close the datagram socket, if open.
+ */
+static void coap_close(void)
+{
+    if (coap_sock >= 0) {
+        close(coap_sock);
+        coap_sock = -1;
+    }
+}
+
+/**
+ * @brief Format samples into payload_buf as CSV records.
+ *
+ * @return int Returns the payload length, or a negative error code on failure.
+ */
+static int coap_format(const struct ws_sample *samples, size_t count)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int ret = snprintk(payload_buf + len, sizeof(payload_buf) - len,
+                           "%u,%u,%lld," WS_SPEED_FMT "," WS_DIRECTION_FMT "\n",
+                           samples[i].station, samples[i].boot,
+                           (long long)samples[i].timestamp,
+                           WS_SPEED_ARGS(samples[i].wind_speed),
+                           WS_DIRECTION_ARGS(samples[i].wind_direction));
+        if (ret <= 0 || ret >= sizeof(payload_buf) - len) {
+            LOG_ERR("op=format_coap err=%d", -ENOMEM);
+            return -ENOMEM;
+        }
+        len += ret;
+    }
+
+    uplink_stats.bytes_formatted += len;
+    return len;
+}
+
+/**
+ * @brief Build a POST of @p payload to CONFIG_UPLINK_COAP_PATH in msg_buf.
+ *
+ * @param pkt   Packet to initialise.
+ * @param type  COAP_TYPE_CON or COAP_TYPE_NON_CON.
+ * @param block Block-wise transfer position, or NULL to send the payload whole.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int coap_build(struct coap_packet *pkt, uint8_t type, struct coap_block_context *block,
+                      const char *payload, size_t len)
+{
+    int ret;
+
+    ret = coap_packet_init(pkt, msg_buf, sizeof(msg_buf), COAP_VERSION_1, type,
+                           COAP_TOKEN_MAX_LEN, coap_next_token(), COAP_METHOD_POST,
+                           coap_next_id());
+    if (ret == 0) {
+        ret = coap_packet_append_option(pkt, COAP_OPTION_URI_PATH,
+                                        (const uint8_t *)CONFIG_UPLINK_COAP_PATH,
+                                        sizeof(CONFIG_UPLINK_COAP_PATH) - 1);
+    }
+    if (ret == 0) {
+        ret = coap_append_option_int(pkt, COAP_OPTION_CONTENT_FORMAT,
+                                     COAP_CONTENT_FORMAT_TEXT_PLAIN);
+    }
+    if (ret == 0 && block != NULL) {
+        ret = coap_append_block1_option(pkt, block);
+    }
+    if (ret == 0) {
+        ret = coap_packet_append_payload_marker(pkt);
+    }
+    if (ret == 0) {
+        ret = coap_packet_append_payload(pkt, (const uint8_t *)payload, len);
+    }
+    return ret;
+}
+
+/**
+ * @brief Send a built message, opening the socket if needed.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int coap_transmit(const struct coap_packet *pkt)
+{
+    int ret;
+
+    if (coap_sock < 0) {
+        ret = coap_open();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    if (send(coap_sock, pkt->data, pkt->offset, 0) < 0) {
+        ret = -errno;
+        LOG_DEDUP_FAILURE(&failures, "coap_send", ret);
+        coap_close();
+        return ret;
+    }
+    uplink_stats.bytes_sent += pkt->offset;
+    return 0;
+}
+
+#if defined(CONFIG_UPLINK_COAP_CONFIRMABLE)
+/**
+ * @brief Wait for the acknowledgement of message @p id.
+ *
+ * Datagrams that do not acknowledge @p id, such as late duplicates, are skipped.
+ *
+ * @param code Destination for the response code; COAP_CODE_EMPTY if the response will
+ *             follow separately.
+ *
+ * @return int Returns 0 once acknowledged, -ETIMEDOUT, -ECONNREFUSED if the server reset
+ *         the exchange, or another negative error code.
+ */
+static int coap_await_ack(uint16_t id, int timeout_ms, uint8_t *code)
+{
+    struct pollfd fds = { .fd = coap_sock, .events = POLLIN };
+    int64_t end = k_uptime_get() + timeout_ms;
+    struct coap_packet rsp;
+
+    while (1) {
+        int64_t left = end - k_uptime_get();
+        if (left <= 0) {
+            return -ETIMEDOUT;
+        }
+        int ret = poll(&fds, 1, left);
+        if (ret < 0) {
+            return -errno;
+        }
+        if (ret == 0) {
+            return -ETIMEDOUT;
+        }
+
+        ssize_t len = recv(coap_sock, rsp_buf, sizeof(rsp_buf), 0);
+        if (len < 0) {
+            return -errno;
+        }
+        if (coap_packet_parse(&rsp, rsp_buf, len, NULL, 0) < 0 ||
+            coap_header_get_id(&rsp) != id) {
+            continue;
+        }
+
+        switch (coap_header_get_type(&rsp)) {
+        case COAP_TYPE_ACK:
+            *code = coap_header_get_code(&rsp);
+            return 0;
+        case COAP_TYPE_RESET:
+            return -ECONNREFUSED;
+        default:
+            continue;
+        }
+    }
+}
+
+/**
+ * @brief Send a confirmable message until it is acknowledged.
+ *
+ * Retransmits CONFIG_UPLINK_COAP_MAX_RETRANSMIT times at most, doubling the timeout each
+ * time as in RFC 7252.
+ *
+ * @param code Destination for the response code.
+ *
+ * @return int Returns 0 once acknowledged with a success or empty code, or a negative error
+ *         code.
+ */
+static int coap_exchange(const struct coap_packet *pkt, uint8_t *code)
+{
+    uint16_t id = coap_header_get_id(pkt);
+    int timeout = CONFIG_UPLINK_COAP_ACK_TIMEOUT_MS;
+    int ret;
+
+    for (int tx = 0; tx <= CONFIG_UPLINK_COAP_MAX_RETRANSMIT; tx++, timeout *= 2) {
+        ret = coap_transmit(pkt);
+        if (ret < 0) {
+            return ret;
+        }
+        ret = coap_await_ack(id, timeout, code);
+        if (ret != -ETIMEDOUT) {
+            break;
+        }
+    }
+    if (ret < 0) {
+        LOG_DEDUP_FAILURE(&failures, "coap_ack", ret);
+        return ret;
+    }
+
+    /* Class 2 (success), or an empty ACK for a separate response */
+    if (*code != COAP_CODE_EMPTY && (*code >> 5) != 2) {
+        LOG_DBG("Server responded %u.%02u", *code >> 5, *code & 0x1f);
+        LOG_DEDUP_FAILURE(&failures, "coap_response", -EIO);
+        return -EIO;
+    }
+    return 0;
+}
+
+/**
+ * @brief Send the payload in confirmable messages.
+ *
+ * A payload larger than one block is sent block-wise with the Block1 option (RFC 7959),
+ * each block acknowledged before the next is sent.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int coap_send_confirmable(const char *payload, size_t len)
+{
+    struct coap_packet pkt;
+    struct coap_block_context block;
+    uint8_t code;
+    int ret;
+
+    if (len <= CONFIG_UPLINK_COAP_BLOCK_SIZE) {
+        ret = coap_build(&pkt, COAP_TYPE_CON, NULL, payload, len);
+        return ret < 0 ? ret : coap_exchange(&pkt, &code);
+    }
+
+    coap_block_transfer_init(&block, COAP_BLOCK_SZX, len);
+    for (size_t offset = 0; offset < len; offset += CONFIG_UPLINK_COAP_BLOCK_SIZE) {
+        block.current = offset;
+        ret = coap_build(&pkt, COAP_TYPE_CON, &block, payload + offset,
+                         MIN(CONFIG_UPLINK_COAP_BLOCK_SIZE, len - offset));
+        if (ret == 0) {
+            ret = coap_exchange(&pkt, &code);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+#else
+/**
+ * @brief Send the payload in non-confirmable messages of at most one block.
+ *
+ * Messages are split between CSV records, so each one can be parsed on its own.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int coap_send_split(const char *payload, size_t len)
+{
+    struct coap_packet pkt;
+    size_t start = 0;
+    int ret;
+
+    while (start < len) {
+        size_t end = start + MIN(CONFIG_UPLINK_COAP_BLOCK_SIZE, len - start);
+
+        if (end < len) {
+            while (payload[end - 1] != '\n') {
+                end--;
+            }
+        }
+        ret = coap_build(&pkt, COAP_TYPE_NON_CON, NULL, payload + start, end - start);
+        if (ret == 0) {
+            ret = coap_transmit(&pkt);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        start = end;
+    }
+    return 0;
+}
+#endif /* CONFIG_UPLINK_COAP_CONFIRMABLE */
+
+/**
+ * @brief Send a sample in a non-confirmable message, without waiting for any response.
+ */
+static int coap_send(const struct ws_sample *sample)
+{
+    int64_t start = k_uptime_ticks();
+    struct coap_packet pkt;
+    int ret;
+
+    ret = coap_format(sample, 1);
+    if (ret >= 0) {
+        ret = coap_build(&pkt, COAP_TYPE_NON_CON, NULL, payload_buf, ret);
+    }
+    if (ret == 0) {
+        ret = coap_transmit(&pkt);
+    }
+    if (ret < 0) {
+        uplink_stats.failures++;
+        return ret;
+    }
+
+    LOG_DEDUP_SUCCESS(&failures);
+    uplink_record_request(start, 1);
+    return 0;
+}
+
+/**
+ * @brief Send samples in one upload, confirmable with CONFIG_UPLINK_COAP_CONFIRMABLE.
+ */
+static int coap_send_samples(const struct ws_sample *samples, size_t count)
+{
+    int64_t start = k_uptime_ticks();
+    int ret;
+
+    ret = coap_format(samples, count);
+    if (ret >= 0) {
+#if defined(CONFIG_UPLINK_COAP_CONFIRMABLE)
+        ret = coap_send_confirmable(payload_buf, ret);
+#else
+        ret = coap_send_split(payload_buf, ret);
+#endif
+    }
+    if (ret < 0) {
+        uplink_stats.failures++;
+        return ret;
+    }
+
+    LOG_DEDUP_SUCCESS(&failures);
+    uplink_record_request(start, count);
+    return 0;
+}
+
+const struct uplink_transport coap_transport = {
+    .name = "coap",
+    .send = coap_send,
+    .send_samples = coap_send_samples,
+    .close = coap_close,
+};
@@ -0,0 +1,192 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/dns_resolve.h>
+#include <string.h>
+
+#include "dns_cache.h"
+#include "log_dedup.h"
+
+LOG_MODULE_REGISTER(dns_cache, CONFIG_WEATHER_STATION_LOG_LEVEL);
+
+/* Time allowed for a background resolution to complete */
+#define DNS_REFRESH_TIMEOUT_MS 2000
+
+/* Refresh this long before expiry so a fresh entry is normally always available */
+#define DNS_REFRESH_MARGIN_MS  (CONFIG_HTTP_DNS_CACHE_TTL * MSEC_PER_SEC / 10)
+
+static struct {
+    const char *host;
+    struct sockaddr_in addr;   /**< Last known-good address */
+    bool valid;
+    int64_t expires;           /**< Uptime (ms) after which the entry is stale */
+    struct in_addr pending;    /**< Address reported by an in-flight refresh */
+    bool pending_valid;
+    bool refreshing;
+} cache;
+
+static struct k_spinlock lock;
+static struct dns_cache_stats stats;
+
+/* Failures of the first lookup (uplink thread) and of refreshes (system workqueue) */
+static struct log_dedup lookup_failures;
+static struct log_dedup refresh_failures;
+
+struct latency_hist dns_cache_lookup_hist;
+
+static void refresh_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(refresh_work, refresh_work_handler);
+
+/**
+ * @brief Store a newly resolved address and schedule its refresh.
+ *
+ * Must be called with the lock held.
+ */
+static void cache_store(struct in_addr sin_addr)
+{
+    cache.addr.sin_addr = sin_addr;
+    cache.valid = true;
+    cache.expires = k_uptime_get() + CONFIG_HTTP_DNS_CACHE_TTL * MSEC_PER_SEC;
+    k_work_reschedule(&refresh_work,
+                      K_MSEC(CONFIG_HTTP_DNS_CACHE_TTL * MSEC_PER_SEC - DNS_REFRESH_MARGIN_MS));
+}
+
+/**
+ * @brief Resolver callback for background refreshes.
+ *
+ * Called once per resolved address and then once with the final status. On
+ * failure the previous address is kept and the refresh is retried later.
+ */
+static void dns_result_cb(enum dns_resolve_status status,
+                          struct dns_addrinfo *info, void *user_data)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (status == DNS_EAI_INPROGRESS && info != NULL) {
+        if (!cache.pending_valid && info->ai_family == AF_INET) {
+            cache.pending = net_sin(&info->ai_addr)->sin_addr;
+            cache.pending_valid = true;
+        }
+        k_spin_unlock(&lock, key);
+        return;
+    }
+
+    bool ok = status == DNS_EAI_ALLDONE && cache.pending_valid;
+
+    cache.refreshing = false;
+    if (ok) {
+        cache_store(cache.pending);
+        stats.refreshes++;
+    } else {
+        stats.failures++;
+        k_work_reschedule(&refresh_work, K_SECONDS(CONFIG_HTTP_DNS_CACHE_RETRY));
+    }
+    k_spin_unlock(&lock, key);
+
+    if (ok) {
+        LOG_DEDUP_SUCCESS(&refresh_failures);
+    } else {
+        /* The last address is kept */
+        LOG_DEDUP_FAILURE(&refresh_failures, "dns_refresh", status);
+    }
+}
+
+/**
+ * @brief Start a non-blocking re-resolution of the cached host.
+ */
+static void refresh_work_handler(struct k_work *work)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (cache.refreshing) {
+        k_spin_unlock(&lock, key);
+        return;
+    }
+    cache.refreshing = true;
+    cache.pending_valid = false;
+    k_spin_unlock(&lock, key);
+
+    int ret = dns_get_addr_info(cache.host, DNS_QUERY_TYPE_A, NULL,
+                                dns_result_cb, NULL, DNS_REFRESH_TIMEOUT_MS);
+    if (ret < 0) {
+        LOG_DEDUP_FAILURE(&refresh_failures, "dns_get_addr_info", ret);
+        key = k_spin_lock(&lock);
+        cache.refreshing = false;
+        stats.failures++;
+        k_work_reschedule(&refresh_work, K_SECONDS(CONFIG_HTTP_DNS_CACHE_RETRY));
+        k_spin_unlock(&lock, key);
+    }
+}
+
+/**
+ * @brief Resolve the host on the calling thread.
+ *
+ * Only used until the first address is known.
+ */
+static int resolve_sync(const char *host, const char *port)
+{
+    struct addrinfo hints = {0}, *res = NULL;
+    int ret;
+
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    ret = getaddrinfo(host, port, &hints, &res);
+    if (ret != 0) {
+        LOG_DEDUP_FAILURE(&lookup_failures, "getaddrinfo", ret);
+        return -EHOSTUNREACH;
+    }
+    LOG_DEDUP_SUCCESS(&lookup_failures);
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    cache.host = host;
+    memcpy(&cache.addr, res->ai_addr, sizeof(cache.addr));
+    cache_store(cache.addr.sin_addr);
+    k_spin_unlock(&lock, key);
+
+    freeaddrinfo(res);
+    return 0;
+}
+
+int dns_cache_lookup(const char *host, const char *port, struct sockaddr_in *addr)
+{
+    uint32_t start = k_cycle_get_32();
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (!cache.valid) {
+        stats.misses++;
+        k_spin_unlock(&lock, key);
+
+        if (resolve_sync(host, port) < 0) {
+            key = k_spin_lock(&lock);
+            stats.failures++;
+            k_spin_unlock(&lock, key);
+            latency_hist_record_cycles(&dns_cache_lookup_hist, start);
+            return -EHOSTUNREACH;
+        }
+        key = k_spin_lock(&lock);
+    } else if (k_uptime_get() >= cache.expires) {
+        /* Serve the last known-good address while it is being refreshed */
+        stats.stale++;
+        if (!cache.refreshing) {
+            k_work_reschedule(&refresh_work, K_NO_WAIT);
+        }
+    } else {
+        stats.hits++;
+    }
+
+    *addr = cache.addr;
+    k_spin_unlock(&lock, key);
+    latency_hist_record_cycles(&dns_cache_lookup_hist, start);
+    return 0;
+}
+
+void dns_cache_get_stats(struct dns_cache_stats *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    *out = stats;
+    k_spin_unlock(&lock, key);
+}
@@ -0,0 +1,395 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <errno.h>
+
+#include "journal.h"
+#include "log_dedup.h"
+#include "uplink.h"
+
+LOG_MODULE_REGISTER(journal, CONFIG_WEATHER_STATION_LOG_LEVEL);
+
+#define JOURNAL_PARTITION_ID FIXED_PARTITION_ID(storage_partition)
+#define JOURNAL_MAGIC        0x57534a31 /* "WSJ1" */
+#define JOURNAL_VERSION      4
+
+/**
+ * @brief On-flash sample record.
+ */
+struct journal_record {
+    int64_t  timestamp;
+    uint16_t wind_speed;
+    int16_t  wind_direction;
+    uint16_t station;
+    uint16_t boot;
+} __packed;
+
+/**
+ * @brief On-flash replay cursor, appended after each delivered block and at startup.
+ *
+ * Entries are told apart by length. The latest mark that still points into the journal
+ * gives the replay position after a reset, so delivered samples are not sent again.
+ * Every entry carries the boot number it was written in; the newest one gives the number
+ * of the next boot.
+ */
+struct journal_mark {
+    uint32_t elem_off;
+    uint16_t sector;  /* JOURNAL_MARK_OLDEST to replay from the oldest entry */
+    uint16_t boot;
+} __packed;
+
+#define JOURNAL_MARK_OLDEST UINT16_MAX
+
+BUILD_ASSERT(sizeof(struct journal_mark) != sizeof(struct journal_record));
+
+static struct flash_sector sectors[CONFIG_WEATHER_STATION_JOURNAL_MAX_SECTORS];
+static struct fcb fcb;
+
+/* Failures to store samples, logged with repeats folded */
+static struct log_dedup failures;
+
+/* Last replayed entry; fe_sector is NULL when replay starts at the oldest entry */
+static struct fcb_entry cursor;
+
+static struct journal_stats stats;
+
+/* Number of this boot, one more than the newest entry's */
+static uint16_t boot;
+
+/* Samples read back for one bulk upload */
+static struct ws_sample replay_buf[CONFIG_UPLINK_BULK_MAX_SAMPLES];
+
+/**
+ * @brief Count the sample records after the replay cursor.
+ */
+static uint32_t count_pending(void)
+{
+    struct fcb_entry loc = cursor;
+    uint32_t count = 0;
+
+    while (fcb_getnext(&fcb, &loc) == 0) {
+        if (loc.fe_data_len == sizeof(struct journal_record)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Set the replay cursor from the marks stored in the journal.
+ *
+ * A mark only counts if it points behind itself: into a sector already walked past or
+ * at an earlier entry of its own sector. Otherwise the sector it points into has been
+ * erased since, and replay starts at the oldest entry, as it would have before the reset.
+ *
+ * @param newest Set to the newest entry, with fe_sector NULL if the journal is empty.
+ */
+static void restore_cursor(struct fcb_entry *newest)
+{
+    ATOMIC_DEFINE(walked, CONFIG_WEATHER_STATION_JOURNAL_MAX_SECTORS);
+    struct fcb_entry loc = { 0 };
+    struct journal_mark mark;
+
+    cursor = (struct fcb_entry){ 0 };
+    *newest = (struct fcb_entry){ 0 };
+    while (fcb_getnext(&fcb, &loc) == 0) {
+        *newest = loc;
+        atomic_set_bit(walked, loc.fe_sector - sectors);
+        if (loc.fe_data_len != sizeof(mark) ||
+            flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), &mark, sizeof(mark)) < 0) {
+            continue;
+        }
+
+        if (mark.sector < fcb.f_sector_cnt && atomic_test_bit(walked, mark.sector) &&
+            (&sectors[mark.sector] != loc.fe_sector || mark.elem_off < loc.fe_elem_off)) {
+            cursor = (struct fcb_entry){
+                .fe_sector = &sectors[mark.sector],
+                .fe_elem_off = mark.elem_off,
+            };
+        } else {
+            cursor = (struct fcb_entry){ 0 };
+        }
+    }
+}
+
+/**
+ * @brief Take the boot number that follows the newest entry's.
+ *
+ * An empty journal, freshly formatted, starts again from boot 0.
+ */
+static void restore_boot(const struct fcb_entry *newest)
+{
+    uint16_t last;
+    off_t off;
+
+    if (newest->fe_sector == NULL) {
+        boot = 0;
+        return;
+    }
+
+    off = newest->fe_data_len == sizeof(struct journal_record) ?
+          offsetof(struct journal_record, boot) : offsetof(struct journal_mark, boot);
+    if (flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(*newest) + off, &last,
+                        sizeof(last)) < 0) {
+        /* Unreadable: better a boot number repeated than none at all */
+        last = 0;
+    }
+    boot = last + 1;
+}
+
+/**
+ * @brief Erase the oldest sector.
+ */
+static int rotate(void)
+{
+    if (cursor.fe_sector == fcb.f_oldest) {
+        cursor = (struct fcb_entry){ 0 };
+    }
+
+    int ret = fcb_rotate(&fcb);
+    if (ret == 0) {
+        stats.erases++;
+    }
+    return ret;
+}
+
+/**
+ * @brief Write one entry, reclaiming the oldest sector if the journal is full.
+ */
+static int append_entry(const void *data, size_t len)
+{
+    struct fcb_entry loc;
+    int ret;
+
+    ret = fcb_append(&fcb, len, &loc);
+    if (ret == -ENOSPC) {
+        /* Full: reclaim the oldest sector and recount what is left */
+        ret = rotate();
+        if (ret < 0) {
+            return ret;
+        }
+        uint32_t pending = count_pending();
+        stats.dropped += stats.pending - pending;
+        stats.pending = pending;
+
+        ret = fcb_append(&fcb, len, &loc);
+    }
+    if (ret < 0) {
+        LOG_DEDUP_FAILURE(&failures, "fcb_append", ret);
+        return ret;
+    }
+
+    ret = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), data, len);
+    if (ret < 0) {
+        LOG_DEDUP_FAILURE(&failures, "flash_area_write", ret);
+        return ret;
+    }
+
+    ret = fcb_append_finish(&fcb, &loc);
+    if (ret < 0) {
+        return ret;
+    }
+
+    LOG_DEDUP_SUCCESS(&failures);
+    return 0;
+}
+
+int journal_append(const struct ws_sample *sample)
+{
+    struct journal_record rec = {
+        .timestamp = sample->timestamp,
+        .wind_speed = sample->wind_speed,
+        .wind_direction = sample->wind_direction,
+        .station = sample->station,
+        .boot = sample->boot,
+    };
+    int ret;
+
+    ret = append_entry(&rec, sizeof(rec));
+    if (ret < 0) {
+        return ret;
+    }
+
+    stats.appended++;
+    stats.pending++;
+    return 0;
+}
+
+/**
+ * @brief Record the replay position and the boot number in the journal.
+ *
+ * If making room for the mark erases the cursor's sector, the mark lands in that sector
+ * again, ahead of where it points, and is ignored on the next start.
+ */
+static int append_mark(void)
+{
+    struct journal_mark mark = {
+        .elem_off = cursor.fe_elem_off,
+        .sector = cursor.fe_sector == NULL ? JOURNAL_MARK_OLDEST : cursor.fe_sector - sectors,
+        .boot = boot,
+    };
+
+    return append_entry(&mark, sizeof(mark));
+}
+
+int journal_init(void)
+{
+    uint32_t sector_cnt = ARRAY_SIZE(sectors);
+    int ret;
+
+    ret = flash_area_get_sectors(JOURNAL_PARTITION_ID, &sector_cnt, sectors);
+    if (ret < 0) {
+        LOG_ERR("op=flash_area_get_sectors err=%d", ret);
+        return ret;
+    }
+
+    fcb.f_magic = JOURNAL_MAGIC;
+    fcb.f_version = JOURNAL_VERSION;
+    fcb.f_sector_cnt = sector_cnt;
+    fcb.f_scratch_cnt = 0;
+    fcb.f_sectors = sectors;
+
+    ret = fcb_init(JOURNAL_PARTITION_ID, &fcb);
+    if (ret == -ENOMSG) {
+        /* Written with an older record format: start afresh */
+        const struct flash_area *fa;
+
+        ret = flash_area_open(JOURNAL_PARTITION_ID, &fa);
+        if (ret == 0) {
+            ret = flash_area_erase(fa, 0, fa->fa_size);
+            flash_area_close(fa);
+        }
+        if (ret == 0) {
+            ret = fcb_init(JOURNAL_PARTITION_ID, &fcb);
+        }
+    }
+    if (ret < 0) {
+        LOG_ERR("op=fcb_init err=%d", ret);
+        return ret;
+    }
+
+    struct fcb_entry newest;
+
+    restore_cursor(&newest);
+    restore_boot(&newest);
+    stats.pending = count_pending();
+
+    /* Record this boot's number, so the next boot counts on from it */
+    ret = append_mark();
+    if (ret < 0) {
+        LOG_ERR("op=journal_mark err=%d", ret);
+        return ret;
+    }
+    return 0;
+}
+
+uint16_t journal_boot(void)
+{
+    return boot;
+}
+
+/**
+ * @brief Upload the next block of stored samples.
+ *
+ * A block holds the samples of one boot, so their uptimes can be sent as they are.
+ *
+ * @return int Returns the number of samples uploaded, 0 if none are left, or a negative
+ *         error code on failure.
+ */
+static int replay_block(void)
+{
+    struct fcb_entry loc = cursor;
+    struct fcb_entry last = cursor;
+    struct journal_record rec;
+    size_t count = 0;
+    int ret;
+
+    /* A failed fcb_getnext() moves loc past the last entry, so the cursor follows last */
+    while (count < ARRAY_SIZE(replay_buf) && fcb_getnext(&fcb, &loc) == 0) {
+        if (loc.fe_data_len != sizeof(rec)) {
+            last = loc;
+            continue;
+        }
+        ret = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), &rec, sizeof(rec));
+        if (ret < 0) {
+            return ret;
+        }
+        if (count > 0 && rec.boot != replay_buf[0].boot) {
+            /* The next boot's samples go in the next block */
+            break;
+        }
+        last = loc;
+        replay_buf[count].timestamp = rec.timestamp;
+        replay_buf[count].wind_speed = rec.wind_speed;
+        replay_buf[count].wind_direction = rec.wind_direction;
+        replay_buf[count].station = rec.station;
+        replay_buf[count].boot = rec.boot;
+        count++;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    ret = uplink_send_samples(replay_buf, count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    cursor = last;
+    stats.replayed += count;
+    stats.pending -= MIN(stats.pending, count);
+
+    /*
+     * Erase the sectors before the cursor's: they are full, as writing has moved on, and
+     * all their samples have been delivered. The cursor's own sector is kept, and the
+     * mark skips its delivered entries after a reset.
+     */
+    while (fcb.f_oldest != cursor.fe_sector) {
+        ret = rotate();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return count;
+}
+
+int journal_replay(void)
+{
+    struct fcb_entry start = cursor;
+    int total = 0;
+    int ret = 0;
+
+    for (int i = 0; i < CONFIG_WEATHER_STATION_JOURNAL_REPLAY_BURST; i++) {
+        ret = replay_block();
+        if (ret <= 0) {
+            break;
+        }
+        total += ret;
+    }
+
+    /* Record the new position once per burst, not per block */
+    if (cursor.fe_sector != start.fe_sector || cursor.fe_elem_off != start.fe_elem_off) {
+        int err = append_mark();
+
+        if (err < 0 && ret >= 0) {
+            ret = err;
+        }
+    }
+    return ret < 0 ? ret : total;
+}
+
+uint32_t journal_pending(void)
+{
+    return stats.pending;
+}
+
+void journal_get_stats(struct journal_stats *out)
+{
+    *out = stats;
+}
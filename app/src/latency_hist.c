@@ -0,0 +1,48 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "latency_hist.h"
+
+uint32_t latency_hist_count(const struct latency_hist *hist)
+{
+    uint32_t count = 0;
+
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        count += (uint32_t)atomic_get(&hist->buckets[i]);
+    }
+    return count;
+}
+
+uint32_t latency_hist_percentile(const struct latency_hist *hist, uint32_t pct)
+{
+    uint32_t counts[LATENCY_HIST_BUCKETS];
+    uint32_t total = 0;
+
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        counts[i] = (uint32_t)atomic_get(&hist->buckets[i]);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    /* Rank of the percentile, rounded up so p100 is the slowest value */
+    uint32_t rank = (uint32_t)(((uint64_t)total * pct + 99) / 100);
+    uint32_t seen = 0;
+
+    for (int i = 0; i < LATENCY_HIST_BUCKETS - 1; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return BIT(i);
+        }
+    }
+    return UINT32_MAX;
+}
+
+void latency_hist_reset(struct latency_hist *hist)
+{
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        atomic_clear(&hist->buckets[i]);
+    }
+}
@@ -0,0 +1,37 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+
+#include "log_dedup.h"
+
+bool log_dedup_failure(struct log_dedup *dedup, const char *op, int err,
+                       struct log_dedup *prev)
+{
+    int64_t now = k_uptime_get();
+
+    if (op == dedup->op && err == dedup->err && now - dedup->logged_ms < LOG_DEDUP_MS) {
+        dedup->repeats++;
+        return false;
+    }
+
+    *prev = *dedup;
+    dedup->op = op;
+    dedup->err = err;
+    dedup->repeats = 0;
+    dedup->logged_ms = now;
+    return true;
+}
+
+bool log_dedup_success(struct log_dedup *dedup, struct log_dedup *prev)
+{
+    if (dedup->op == NULL) {
+        return false;
+    }
+
+    *prev = *dedup;
+    dedup->op = NULL;
+    dedup->repeats = 0;
+    return true;
+}
@@ -17,28 +17,83 @@
 #include <zephyr/random/random.h>
 #include <stdio.h>
 
-LOG_MODULE_REGISTER(main);
+LOG_MODULE_REGISTER(main, CONFIG_WEATHER_STATION_LOG_LEVEL);
 
 #include "wifi.h"
-#include "sockets.h"
+#include "uplink.h"
+#include "dns_cache.h"
 #include "weather_station.h"
+#include "pipeline.h"
+#include "journal.h"
+#include "wind_vane.h"
+#include "wind_stats.h"
+#include "wmk_sensor.h"
+#include "bench.h"
+#include "reporting.h"
 
-#define GPIO_0   DT_NODELABEL(gpio0)
-#define GPIO_PIN 27
+BUILD_ASSERT(WS_NUM_STATIONS > 0, "no sparkfun,weather-meter-kit node enabled in the devicetree");
 
-/* Get device instances */
-const struct device *gpio_dev = DEVICE_DT_GET(GPIO_0);
-const struct device *adc_dev = DEVICE_DT_GET(DT_NODELABEL(adc0));
+/* Seconds between pipeline and uplink counter reports */
+#define STATS_INTERVAL 60
 
-/* Global weather station instance */
-WeatherStation ws;
+/* Weather meter kit sensor devices declared in the devicetree */
+#define STATION_DEVICE(node_id) DEVICE_DT_GET(node_id),
+static const struct device *const station_devs[] = {
+    DT_FOREACH_STATUS_OKAY(sparkfun_weather_meter_kit, STATION_DEVICE)
+};
 
+/* The first num_stations of these are ready */
+static const struct device *stations[WS_NUM_STATIONS];
+static size_t num_stations;
 
 /**
- * @brief Cycle Executive.
+ * @brief Report the wake-up, radio and CPU budget since the previous report.
  *
- * Initializes the ADC and weather station, connects to Wi-Fi, and enters the main loop,
- * periodically collecting sensor data and transmitting it to csse4011-iot.uqcloud.net server.
+ * Rates are per minute so they can be compared between sampling configurations.
+ */
+static void report_budget(const struct pipeline_stats *pipe)
+{
+    static struct pipeline_stats prev;
+    static int64_t prev_ms;
+    int64_t now = k_uptime_get();
+    uint32_t minutes_x100 = MAX(1, (uint32_t)((now - prev_ms) / 600));
+
+    LOG_INF("Budget: %u sampler + %u uplink wake-ups/min, radio %u ms/min in %u sessions"
+            " (%u failed)",
+            (pipe->sampler_wakeups - prev.sampler_wakeups) * 100 / minutes_x100,
+            (pipe->uplink_wakeups - prev.uplink_wakeups) * 100 / minutes_x100,
+            (pipe->radio_on_ms - prev.radio_on_ms) * 100 / minutes_x100,
+            pipe->radio_sessions - prev.radio_sessions,
+            pipe->radio_failures - prev.radio_failures);
+
+#if defined(CONFIG_SCHED_THREAD_USAGE_ALL)
+    static k_thread_runtime_stats_t prev_cpu;
+    k_thread_runtime_stats_t cpu;
+
+    if (k_thread_runtime_stats_all_get(&cpu) == 0) {
+        uint64_t total = cpu.total_cycles - prev_cpu.total_cycles;
+        uint64_t elapsed = cpu.execution_cycles - prev_cpu.execution_cycles;
+
+        if (elapsed > 0) {
+            LOG_INF("CPU busy %u.%02u%%", (uint32_t)(total * 100 / elapsed),
+                    (uint32_t)(total * 10000 / elapsed % 100));
+        }
+        prev_cpu = cpu;
+    }
+#endif
+
+    prev = *pipe;
+    prev_ms = now;
+}
+
+
+/**
+ * @brief Application entry point.
+ *
+ * Starts connecting to Wi-Fi and starts the sampling and uplink threads, which collect data from the
+ * weather station sensors declared in the devicetree and transmit it to
+ * csse4011-iot.uqcloud.net server.
+ * The main thread then periodically reports the pipeline and uplink counters.
  *
  * @return Always returns 0.
  */
@@ -46,21 +101,124 @@ int main(void)
 {
     printk("Starting program\n");
 
-    /* Initialize WiFi and weather station */
-	wifi_connect();
-    weather_station_init(&ws, adc_dev, gpio_dev, GPIO_PIN);
-    LOG_INF("Weather station initialised\n");
+    /* WiFi connects in the background; the weather stations are initialised as sensor devices */
+    wifi_start();
+    if (uplink_init() < 0) {
+        LOG_ERR("Uplink credentials unavailable");
+    }
+    for (size_t i = 0; i < ARRAY_SIZE(station_devs); i++) {
+        if (!device_is_ready(station_devs[i])) {
+            LOG_ERR("Weather station %s not ready", station_devs[i]->name);
+            continue;
+        }
+        stations[num_stations++] = station_devs[i];
+    }
+#if defined(CONFIG_WEATHER_STATION_JOURNAL)
+    if (journal_init() < 0) {
+        LOG_ERR("Sample journal unavailable");
+    } else {
+        weather_station_set_boot(journal_boot());
+        LOG_INF("Boot %u", journal_boot());
+    }
+#endif
+
+#if defined(CONFIG_WEATHER_STATION_BENCH)
+    if (num_stations > 0) {
+        bench_run(stations[0]);
+    }
+#endif
 
-    /* Main loop */
+    pipeline_start(stations, num_stations);
+
+    /* Report pipeline and uplink counters */
     while (1) {
-        float wind_speed = weather_station_get_wind_speed(&ws);
-        float wind_direction = weather_station_get_wind_direction(&ws);
-        printk("Wind Speed: %f, Wind Direction: %f\n", (double)wind_speed, (double)wind_direction);
-        if (http_get_dynamic(wind_speed, wind_direction) < 0) {
-            LOG_INF("Error sending GET request.");
+        k_sleep(K_SECONDS(STATS_INTERVAL));
+
+        struct pipeline_stats pipe;
+        pipeline_get_stats(&pipe);
+        LOG_INF("Pipeline: %u sampled, %u sent, %u dropped, depth %u (max %u), late %u us max",
+                pipe.produced, pipe.consumed, pipe.dropped, pipe.depth, pipe.high_water,
+                pipe.max_late_us);
+        if (pipe.delivered > 0) {
+            LOG_INF("Sample to send (ms): last %u, max %u, avg %u", pipe.delivery_last_ms,
+                    pipe.delivery_max_ms, (uint32_t)(pipe.delivery_total_ms / pipe.delivered));
+        }
+        report_budget(&pipe);
+#if defined(CONFIG_WEATHER_STATION_ADAPTIVE_REPORTING)
+        struct reporting_stats rep;
+        reporting_get_stats(&rep);
+        if (rep.samples > 0) {
+            LOG_INF("Reporting: %u of %u samples suppressed (%u%%); sent %u changes, %u gusts,"
+                    " %u shifts, %u heartbeats", rep.suppressed, rep.samples,
+                    rep.suppressed * 100 / rep.samples, rep.changes, rep.gusts, rep.shifts,
+                    rep.heartbeats);
+        }
+#endif
+#if defined(CONFIG_INIT_STACKS) && defined(CONFIG_THREAD_STACK_INFO)
+        LOG_INF("Stack unused: sampler %u of %u, uplink %u of %u bytes",
+                pipe.sampler_stack_unused, CONFIG_WEATHER_STATION_SAMPLER_STACK_SIZE,
+                pipe.uplink_stack_unused, CONFIG_WEATHER_STATION_UPLINK_STACK_SIZE);
+#endif
+
+        struct uplink_stats stats;
+        uplink_get_stats(&stats);
+        LOG_INF("Uplink: %u ok (%u samples), %u failed, %u connects, %u reconnects",
+                stats.requests, stats.samples, stats.failures, stats.connects,
+                stats.reconnects);
+        if (stats.requests > 0) {
+            LOG_INF("Uplink latency (us): last %u, min %u, max %u, avg %u",
+                    stats.last_us, stats.min_us, stats.max_us,
+                    (uint32_t)(stats.total_us / stats.requests));
+            LOG_INF("Uplink bytes per request: %u sent, %u formatted",
+                    stats.bytes_sent / stats.requests, stats.bytes_formatted / stats.requests);
+        }
+        if (stats.connects > 0) {
+            LOG_INF("Uplink connect/handshake (us): last %u, max %u, avg %u",
+                    stats.connect_last_us, stats.connect_max_us,
+                    (uint32_t)(stats.connect_total_us / stats.connects));
+        }
+
+        struct wifi_stats wifi;
+        wifi_get_stats(&wifi);
+        LOG_INF("WiFi: %u connects, %u attempts, %u failures, %u lost, backoff %u ms",
+                wifi.connects, wifi.attempts, wifi.failures, wifi.lost, wifi.backoff_ms);
+
+        struct dns_cache_stats dns;
+        dns_cache_get_stats(&dns);
+        LOG_INF("DNS cache: %u hits, %u misses, %u stale, %u refreshes, %u failures",
+                dns.hits, dns.misses, dns.stale, dns.refreshes, dns.failures);
+
+#if defined(CONFIG_WEATHER_STATION_VANE_OVERSAMPLING)
+        struct wind_vane_stats vane;
+        wind_vane_get_stats(&vane);
+        LOG_INF("Vane: %u samples, %u invalid, %u errors%s",
+                vane.samples, vane.invalid, vane.errors, vane.paced ? " (paced)" : "");
+#endif
+
+#if defined(CONFIG_WEATHER_STATION_WIND_STATS)
+        for (size_t s = 0; s < num_stations; s++) {
+            struct wind_stats_report wind;
+            wind_stats_get(s, &wind);
+            const struct wind_stats_window *periods[] = { &wind.short_term, &wind.long_term };
+            for (size_t i = 0; i < ARRAY_SIZE(periods); i++) {
+                const struct wind_stats_window *w = periods[i];
+                LOG_INF("%s wind %u min: mean " WS_SPEED_FMT " (" WS_SPEED_FMT " to "
+                        WS_SPEED_FMT "), gust " WS_SPEED_FMT ", direction " WS_DIRECTION_FMT
+                        " sd " WS_DIRECTION_FMT, stations[s]->name, i == 0 ? 2 : 10,
+                        WS_SPEED_ARGS(w->mean), WS_SPEED_ARGS(w->min), WS_SPEED_ARGS(w->max),
+                        WS_SPEED_ARGS(w->gust), WS_DIRECTION_ARGS(w->direction),
+                        WS_DIRECTION_ARGS(w->direction_sd));
+            }
         }
+#endif
 
-        k_msleep(1000);
+#if defined(CONFIG_WEATHER_STATION_JOURNAL)
+        struct journal_stats journal;
+        journal_get_stats(&journal);
+        LOG_INF("Journal: %u pending, %u stored, %u replayed, %u dropped, %u erases",
+                journal.pending, journal.appended, journal.replayed, journal.dropped,
+                journal.erases);
+#endif
     }
     return 0;
 }
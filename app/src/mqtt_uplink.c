@@ -0,0 +1,326 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/mqtt.h>
+#include <errno.h>
+
+#include "dns_cache.h"
+#include "log_dedup.h"
+#include "uplink.h"
+
+LOG_MODULE_REGISTER(uplink_mqtt, CONFIG_WEATHER_STATION_LOG_LEVEL);
+
+/* Longest CSV record: "<boot>,<uptime ms>,<speed>,<direction>\n" */
+#define MQTT_RECORD_MAX 46
+
+/* Longest topic: the prefix and a 16-bit station id */
+#define MQTT_TOPIC_MAX (sizeof(CONFIG_UPLINK_MQTT_TOPIC_PREFIX) + 5)
+
+/* Packets other than PUBLISH are small; payloads are sent from payload_buf, not copied */
+static uint8_t rx_buf[128];
+static uint8_t tx_buf[64 + MQTT_TOPIC_MAX];
+
+static struct mqtt_client client;
+static struct sockaddr_storage broker;
+
+/* Connection state, updated by the event handler */
+static bool sock_open;     /* Socket open; mqtt_abort() is needed to close it */
+static bool connected;     /* CONNACK accepted and no disconnect since */
+static int connack_result; /* -EINPROGRESS until the CONNACK arrives */
+static uint32_t unacked;   /* QoS 1 publishes not acknowledged yet */
+static uint16_t message_id;
+
+static char topic_buf[MQTT_TOPIC_MAX];
+static char payload_buf[CONFIG_UPLINK_BULK_MAX_SAMPLES * MQTT_RECORD_MAX];
+
+/* Failures of the broker connection, logged with repeats folded */
+static struct log_dedup failures;
+
+static void mqtt_evt_handler(struct mqtt_client *c, const struct mqtt_evt *evt)
+{
+    switch (evt->type) {
+    case MQTT_EVT_CONNACK:
+        connack_result = evt->result;
+        connected = evt->result == 0;
+        if (connected && !evt->param.connack.session_present_flag) {
+            LOG_INF("Session created on the broker");
+        }
+        break;
+    case MQTT_EVT_DISCONNECT:
+        connected = false;
+        break;
+    case MQTT_EVT_PUBACK:
+        if (unacked > 0) {
+            unacked--;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Close the broker connection, if open.
+ *
+ * The broker keeps the session, since it was opened with clean_session unset.
+ */
+static void mqtt_close(void)
+{
+    if (sock_open) {
+        mqtt_abort(&client);
+        sock_open = false;
+        connected = false;
+        LOG_DBG("Connection closed");
+    }
+}
+
+/**
+ * @brief Process packets from the broker.
+ *
+ * @param timeout_ms How long to wait for the first packet; 0 to only take what has arrived.
+ *
+ * @return int Returns 0 on success or timeout, or a negative error code if the connection
+ *         failed.
+ */
+static int mqtt_process(int timeout_ms)
+{
+    struct pollfd fds = {
+        .fd = client.transport.tcp.sock,
+        .events = POLLIN,
+    };
+    int ret;
+
+    while ((ret = poll(&fds, 1, timeout_ms)) > 0) {
+        if (fds.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            return -ECONNRESET;
+        }
+        ret = mqtt_input(&client);
+        if (ret < 0) {
+            return ret;
+        }
+        timeout_ms = 0;
+    }
+    return ret < 0 ? -errno : 0;
+}
+
+/**
+ * @brief Process packets from the broker until @p cond holds.
+ */
+static int mqtt_wait(bool (*cond)(void))
+{
+    int64_t end = k_uptime_get() + CONFIG_UPLINK_MQTT_TIMEOUT_MS;
+
+    while (!cond()) {
+        int64_t left = end - k_uptime_get();
+        if (left <= 0) {
+            return -ETIMEDOUT;
+        }
+        int ret = mqtt_process(left);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+static bool connack_received(void)
+{
+    return connack_result != -EINPROGRESS;
+}
+
+static bool all_acked(void)
+{
+    return unacked == 0;
+}
+
+/**
+ * @brief Connect to the broker and resume the persistent session.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int mqtt_open(void)
+{
+    struct sockaddr_in *addr = (struct sockaddr_in *)&broker;
+    int ret;
+
+    ret = dns_cache_lookup(CONFIG_UPLINK_MQTT_BROKER, STRINGIFY(CONFIG_UPLINK_MQTT_BROKER_PORT),
+                           addr);
+    if (ret < 0) {
+        return ret;
+    }
+    addr->sin_port = htons(CONFIG_UPLINK_MQTT_BROKER_PORT);
+
+    mqtt_client_init(&client);
+    client.broker = &broker;
+    client.evt_cb = mqtt_evt_handler;
+    client.client_id.utf8 = (const uint8_t *)CONFIG_UPLINK_MQTT_CLIENT_ID;
+    client.client_id.size = sizeof(CONFIG_UPLINK_MQTT_CLIENT_ID) - 1;
+    client.protocol_version = MQTT_VERSION_3_1_1;
+    client.clean_session = 0;
+    client.rx_buf = rx_buf;
+    client.rx_buf_size = sizeof(rx_buf);
+    client.tx_buf = tx_buf;
+    client.tx_buf_size = sizeof(tx_buf);
+    client.transport.type = MQTT_TRANSPORT_NON_SECURE;
+
+    connack_result = -EINPROGRESS;
+    unacked = 0;
+
+    int64_t start = k_uptime_ticks();
+    ret = mqtt_connect(&client);
+    if (ret < 0) {
+        LOG_DEDUP_FAILURE(&failures, "mqtt_connect", ret);
+        return ret;
+    }
+    sock_open = true;
+
+    ret = mqtt_wait(connack_received);
+    if (ret == 0 && connack_result != 0) {
+        ret = -ECONNREFUSED;
+    }
+    if (ret < 0) {
+        LOG_DBG("CONNACK %d", connack_result);
+        LOG_DEDUP_FAILURE(&failures, "mqtt_connack", ret);
+        mqtt_close();
+        return ret;
+    }
+
+    uplink_record_connect(start);
+    return 0;
+}
+
+/**
+ * @brief Publish one station's samples in a single message.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int mqtt_publish_station(const struct ws_sample *samples, size_t count)
+{
+    struct mqtt_publish_param param = { 0 };
+    size_t len = 0;
+    int ret;
+
+    for (size_t i = 0; i < count; i++) {
+        ret = snprintk(payload_buf + len, sizeof(payload_buf) - len,
+                       "%u,%lld," WS_SPEED_FMT "," WS_DIRECTION_FMT "\n", samples[i].boot,
+                       (long long)samples[i].timestamp, WS_SPEED_ARGS(samples[i].wind_speed),
+                       WS_DIRECTION_ARGS(samples[i].wind_direction));
+        if (ret <= 0 || ret >= sizeof(payload_buf) - len) {
+            LOG_ERR("op=format_publish err=%d", -ENOMEM);
+            return -ENOMEM;
+        }
+        len += ret;
+    }
+
+    ret = snprintk(topic_buf, sizeof(topic_buf), CONFIG_UPLINK_MQTT_TOPIC_PREFIX "%u",
+                   samples[0].station);
+    param.message.topic.topic.utf8 = (const uint8_t *)topic_buf;
+    param.message.topic.topic.size = ret;
+    param.message.topic.qos = CONFIG_UPLINK_MQTT_QOS;
+    param.message.payload.data = (uint8_t *)payload_buf;
+    param.message.payload.len = len;
+    /* Message ids are for QoS 1 acknowledgements, and must not be 0 */
+    message_id = message_id == UINT16_MAX ? 1 : message_id + 1;
+    param.message_id = message_id;
+
+    ret = mqtt_publish(&client, &param);
+    if (ret < 0) {
+        return ret;
+    }
+    uplink_stats.bytes_formatted += len + param.message.topic.topic.size;
+    uplink_stats.bytes_sent += len + param.message.topic.topic.size;
+    if (CONFIG_UPLINK_MQTT_QOS > 0) {
+        unacked++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Publish samples, one message per run of samples from the same station.
+ *
+ * With QoS 1, waits until the broker has acknowledged every message.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int mqtt_publish_samples(const struct ws_sample *samples, size_t count)
+{
+    size_t first = 0;
+    int ret;
+
+    for (size_t i = 1; i <= count; i++) {
+        if (i < count && samples[i].station == samples[first].station) {
+            continue;
+        }
+        ret = mqtt_publish_station(&samples[first], i - first);
+        if (ret < 0) {
+            return ret;
+        }
+        first = i;
+    }
+
+    return mqtt_wait(all_acked);
+}
+
+/**
+ * @brief Publish samples over the long-lived broker connection.
+ *
+ * Connects if needed. If the connection turns out to have been lost, it is re-established
+ * and the samples are published again.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int mqtt_send_samples(const struct ws_sample *samples, size_t count)
+{
+    int64_t start = k_uptime_ticks();
+    int ret = -ENOTCONN;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (sock_open) {
+            /* Take in what the broker sent since the last publish, and keep the session alive */
+            ret = mqtt_process(0);
+            if (ret == 0) {
+                ret = mqtt_live(&client);
+            }
+            if ((ret < 0 && ret != -EAGAIN) || !connected) {
+                mqtt_close();
+                uplink_stats.reconnects++;
+            }
+        }
+        if (!sock_open) {
+            ret = mqtt_open();
+            if (ret < 0) {
+                uplink_stats.failures++;
+                return ret;
+            }
+        }
+
+        ret = mqtt_publish_samples(samples, count);
+        if (ret == 0) {
+            LOG_DEDUP_SUCCESS(&failures);
+            uplink_record_request(start, count);
+            return 0;
+        }
+        LOG_DEDUP_FAILURE(&failures, "mqtt_publish", ret);
+        mqtt_close();
+        uplink_stats.reconnects++;
+    }
+
+    uplink_stats.failures++;
+    return ret;
+}
+
+static int mqtt_send(const struct ws_sample *sample)
+{
+    return mqtt_send_samples(sample, 1);
+}
+
+const struct uplink_transport mqtt_transport = {
+    .name = "mqtt",
+    .send = mqtt_send,
+    .send_samples = mqtt_send_samples,
+    .close = mqtt_close,
+};
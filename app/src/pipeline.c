@@ -0,0 +1,409 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+LOG_MODULE_REGISTER(pipeline, CONFIG_WEATHER_STATION_LOG_LEVEL);
+
+#include "pipeline.h"
+#include "uplink.h"
+#include "wifi.h"
+#include "journal.h"
+#include "wind_stats.h"
+#include "reporting.h"
+#include "wmk_sensor.h"
+
+#define SAMPLER_PRIORITY 5
+#define UPLINK_PRIORITY  7
+
+/* Samples per 2 minute mean sent with CONFIG_WEATHER_STATION_WIND_STATS_UPLINK */
+#define REPORT_SAMPLES MAX(1, WIND_STATS_SHORT_MS / CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS)
+
+K_MSGQ_DEFINE(sample_q, sizeof(struct ws_sample), CONFIG_WEATHER_STATION_QUEUE_DEPTH, 4);
+
+K_THREAD_STACK_DEFINE(sampler_stack, CONFIG_WEATHER_STATION_SAMPLER_STACK_SIZE);
+K_THREAD_STACK_DEFINE(uplink_stack, CONFIG_WEATHER_STATION_UPLINK_STACK_SIZE);
+static struct k_thread sampler_thread;
+static struct k_thread uplink_thread;
+
+/* Written by the sampling thread only, except for the uplink and radio counters */
+static struct pipeline_stats stats;
+
+struct latency_hist pipeline_trace_hist;
+
+#if defined(CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE)
+BUILD_ASSERT(CONFIG_WEATHER_STATION_RADIO_WAKE_DEPTH <= CONFIG_WEATHER_STATION_QUEUE_DEPTH,
+             "the radio wake depth must fit in the sample queue");
+
+/* Given by the sampling thread when the queue reaches the radio wake depth */
+static K_SEM_DEFINE(backlog_sem, 0, 1);
+#endif
+
+#if defined(CONFIG_UPLINK_BATCH)
+/* Set by the sampling thread when the batch must be sent as soon as the queue is drained */
+static atomic_t flush_requested;
+#endif
+
+/**
+ * @brief Queue a sample, discarding the oldest one if the queue is full.
+ */
+static void sample_put(const struct ws_sample *sample)
+{
+    struct ws_sample discard;
+
+    while (k_msgq_put(&sample_q, sample, K_NO_WAIT) != 0) {
+        if (k_msgq_get(&sample_q, &discard, K_NO_WAIT) == 0) {
+            stats.dropped++;
+        }
+    }
+
+    uint32_t depth = k_msgq_num_used_get(&sample_q);
+    if (depth > stats.high_water) {
+        stats.high_water = depth;
+    }
+#if defined(CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE)
+    if (depth >= CONFIG_WEATHER_STATION_RADIO_WAKE_DEPTH) {
+        k_sem_give(&backlog_sem);
+    }
+#endif
+}
+
+#if defined(CONFIG_WEATHER_STATION_ADAPTIVE_REPORTING)
+/**
+ * @brief Have the queued samples sent without waiting for the radio wake depth or the batch.
+ */
+static void send_now(void)
+{
+#if defined(CONFIG_UPLINK_BATCH)
+    atomic_set(&flush_requested, 1);
+#endif
+#if defined(CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE)
+    k_sem_give(&backlog_sem);
+#endif
+}
+#endif
+
+/**
+ * @brief Sampling thread.
+ *
+ * Reads every weather station on a fixed period. Deadlines are absolute, so time spent
+ * sampling (or waiting to be scheduled) does not accumulate as drift.
+ */
+static void sampler_fn(void *p1, void *p2, void *p3)
+{
+    const struct device *const *stations = p1;
+    size_t count = (size_t)p2;
+    int64_t period = k_ms_to_ticks_ceil64(CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS);
+    int64_t next = k_uptime_ticks();
+#if defined(CONFIG_WEATHER_STATION_WIND_STATS_UPLINK)
+    uint32_t until_report = REPORT_SAMPLES;
+#endif
+
+    while (1) {
+        k_sleep(K_TIMEOUT_ABS_TICKS(next));
+        stats.sampler_wakeups++;
+
+        uint32_t late_us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks() - next);
+        if (late_us > stats.max_late_us) {
+            stats.max_late_us = late_us;
+        }
+        next += period;
+
+        for (size_t i = 0; i < count; i++) {
+            struct ws_sample sample;
+            wmk_sensor_read(stations[i], &sample);
+            stats.produced++;
+
+#if defined(CONFIG_WEATHER_STATION_WIND_STATS)
+            wind_stats_add(i, &sample);
+#endif
+#if defined(CONFIG_WEATHER_STATION_WIND_STATS_UPLINK)
+            /* Send the mean of each 2 minute period instead of the raw samples */
+            if (until_report > 1) {
+                continue;
+            }
+
+            struct wind_stats_report report;
+            wind_stats_get(i, &report);
+            sample.wind_speed = report.short_term.mean;
+            sample.wind_direction = report.short_term.direction;
+#endif
+#if defined(CONFIG_WEATHER_STATION_ADAPTIVE_REPORTING)
+            enum reporting_decision decision = reporting_check(i, &sample);
+            if (decision == REPORTING_SUPPRESS) {
+                continue;
+            }
+            sample_put(&sample);
+            if (decision == REPORTING_SEND_NOW) {
+                send_now();
+            }
+#else
+            sample_put(&sample);
+#endif
+        }
+
+#if defined(CONFIG_WEATHER_STATION_WIND_STATS_UPLINK)
+        until_report = until_report > 1 ? until_report - 1 : REPORT_SAMPLES;
+#endif
+    }
+}
+
+/**
+ * @brief Hand a sample to the uplink.
+ *
+ * @return int Returns 0 if the sample was sent (or queued for a batch), or a negative
+ *         error code if it was not accepted.
+ */
+static int uplink_offer(const struct ws_sample *sample)
+{
+#if defined(CONFIG_UPLINK_BATCH)
+    return uplink_batch_add(sample);
+#else
+    return uplink_send(sample);
+#endif
+}
+
+/**
+ * @brief Log a sample handed to the uplink, at most once per trace interval.
+ *
+ * Compiled out with CONFIG_WEATHER_STATION_LOG_LEVEL below info.
+ */
+static void trace_sample(const struct ws_sample *sample)
+{
+#if defined(CONFIG_LOG) && (CONFIG_WEATHER_STATION_LOG_LEVEL >= LOG_LEVEL_INF)
+    static int64_t next_ms;
+    static uint32_t skipped;
+    int64_t now = k_uptime_get();
+
+    if (now < next_ms) {
+        skipped++;
+        return;
+    }
+    next_ms = now + CONFIG_WEATHER_STATION_TRACE_INTERVAL_MS;
+
+    uint32_t start = k_cycle_get_32();
+    LOG_INF("Station %u: Wind Speed: " WS_SPEED_FMT ", Wind Direction: " WS_DIRECTION_FMT
+            " (%u not logged)", sample->station, WS_SPEED_ARGS(sample->wind_speed),
+            WS_DIRECTION_ARGS(sample->wind_direction), skipped);
+    latency_hist_record_cycles(&pipeline_trace_hist, start);
+    skipped = 0;
+#endif
+}
+
+/**
+ * @brief Record how long samples took from being taken to being sent by the uplink.
+ *
+ * Batched samples are only recorded once their batch has been sent, from the batch callback.
+ */
+static void record_delivery(const struct ws_sample *samples, size_t count)
+{
+    int64_t now = k_uptime_get();
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t ms = (uint32_t)(now - samples[i].timestamp);
+
+        stats.delivered++;
+        stats.delivery_last_ms = ms;
+        stats.delivery_total_ms += ms;
+        if (ms > stats.delivery_max_ms) {
+            stats.delivery_max_ms = ms;
+        }
+    }
+}
+
+/**
+ * @brief Send one sample, storing it in the journal if it cannot be delivered.
+ *
+ * With the journal enabled, stored samples are replayed once the uplink accepts samples
+ * again.
+ */
+static void uplink_one(const struct ws_sample *sample)
+{
+#if defined(CONFIG_WEATHER_STATION_JOURNAL)
+    static int64_t next_replay;
+#endif
+
+    stats.consumed++;
+
+    trace_sample(sample);
+    if (uplink_offer(sample) < 0) {
+        LOG_INF("Error sending sample.");
+#if defined(CONFIG_WEATHER_STATION_JOURNAL)
+        journal_append(sample);
+#endif
+        return;
+    }
+#if !defined(CONFIG_UPLINK_BATCH)
+    record_delivery(sample, 1);
+#endif
+
+#if defined(CONFIG_WEATHER_STATION_JOURNAL)
+    if (journal_pending() > 0 && k_uptime_get() >= next_replay) {
+        if (journal_replay() < 0) {
+            next_replay = k_uptime_get() + CONFIG_WEATHER_STATION_JOURNAL_RETRY_MS;
+        }
+    }
+#endif
+}
+
+#if defined(CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE)
+/**
+ * @brief Bring the radio out of its idle state.
+ */
+static int radio_on(void)
+{
+#if defined(CONFIG_WEATHER_STATION_RADIO_IDLE_POWER_SAVE)
+    return wifi_power_save(false);
+#else
+    return wifi_up(K_MSEC(CONFIG_WEATHER_STATION_RADIO_CONNECT_TIMEOUT_MS));
+#endif
+}
+
+/**
+ * @brief Flush any batch and return the radio to its idle state.
+ */
+static void radio_off(void)
+{
+#if defined(CONFIG_UPLINK_BATCH)
+    /* A batch that cannot be sent now stays queued for the next session */
+    atomic_clear(&flush_requested);
+    (void)uplink_batch_flush();
+#endif
+#if defined(CONFIG_WEATHER_STATION_RADIO_IDLE_POWER_SAVE)
+    wifi_power_save(true);
+#else
+    uplink_close();
+    wifi_down();
+#endif
+}
+#endif /* CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE */
+
+#if defined(CONFIG_UPLINK_BATCH)
+/**
+ * @brief Time to wait for the next sample before the queued batch falls due.
+ */
+static k_timeout_t batch_timeout(void)
+{
+    int64_t due = uplink_batch_due();
+
+    return due < 0 ? K_FOREVER : K_TIMEOUT_ABS_MS(due);
+}
+
+/**
+ * @brief Send the queued batch once it has fallen due with no new sample to carry it.
+ *
+ * A batch that cannot be sent stays queued and falls due again later.
+ */
+static void batch_send_due(void)
+{
+#if defined(CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE)
+    int64_t radio_start = k_uptime_get();
+
+    stats.radio_sessions++;
+    if (radio_on() < 0) {
+        stats.radio_failures++;
+    }
+    /* Sends the batch */
+    radio_off();
+    stats.radio_on_ms += (uint32_t)(k_uptime_get() - radio_start);
+#else
+    (void)uplink_batch_flush();
+#endif
+}
+#endif /* CONFIG_UPLINK_BATCH */
+
+/**
+ * @brief Uplink thread.
+ *
+ * Drains the sample queue and sends each sample to the server. With
+ * CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE the radio is idle while samples accumulate, and
+ * is brought up to send them all at once. With CONFIG_UPLINK_BATCH it also wakes up when the
+ * queued batch falls due between samples.
+ */
+static void uplink_fn(void *p1, void *p2, void *p3)
+{
+    struct ws_sample sample;
+
+#if defined(CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE)
+    radio_off();
+#endif
+
+    while (1) {
+#if defined(CONFIG_UPLINK_BATCH)
+        if (k_msgq_get(&sample_q, &sample, batch_timeout()) != 0) {
+            stats.uplink_wakeups++;
+            batch_send_due();
+            continue;
+        }
+#else
+        k_msgq_get(&sample_q, &sample, K_FOREVER);
+#endif
+        stats.uplink_wakeups++;
+
+#if defined(CONFIG_WEATHER_STATION_RADIO_DUTY_CYCLE)
+        /* Hold the sample until the backlog is worth a connection, or it is due */
+        k_sem_take(&backlog_sem,
+                   K_TIMEOUT_ABS_MS(sample.timestamp + CONFIG_WEATHER_STATION_RADIO_MAX_SLEEP_MS));
+        stats.uplink_wakeups++;
+
+        int64_t radio_start = k_uptime_get();
+        stats.radio_sessions++;
+        if (radio_on() < 0) {
+            /* Sending fails fast with the network down; the journal keeps the samples */
+            stats.radio_failures++;
+        }
+
+        do {
+            uplink_one(&sample);
+        } while (k_msgq_get(&sample_q, &sample, K_NO_WAIT) == 0);
+
+        radio_off();
+        k_sem_reset(&backlog_sem);
+        stats.radio_on_ms += (uint32_t)(k_uptime_get() - radio_start);
+#else
+#if !defined(CONFIG_WEATHER_STATION_JOURNAL)
+        /* Without a journal to catch them, hold samples in the queue until WiFi is up */
+        wifi_up(K_FOREVER);
+#endif
+        uplink_one(&sample);
+#if defined(CONFIG_UPLINK_BATCH)
+        if (k_msgq_num_used_get(&sample_q) == 0 && atomic_cas(&flush_requested, 1, 0)) {
+            (void)uplink_batch_flush();
+        }
+#endif
+#endif
+    }
+}
+
+void pipeline_start(const struct device *const *stations, size_t count)
+{
+#if defined(CONFIG_UPLINK_BATCH)
+    uplink_batch_set_callback(record_delivery);
+#endif
+    k_thread_create(&uplink_thread, uplink_stack, K_THREAD_STACK_SIZEOF(uplink_stack),
+                    uplink_fn, NULL, NULL, NULL, UPLINK_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&uplink_thread, "uplink");
+
+    k_thread_create(&sampler_thread, sampler_stack, K_THREAD_STACK_SIZEOF(sampler_stack),
+                    sampler_fn, (void *)stations, (void *)count, NULL, SAMPLER_PRIORITY, 0,
+                    K_NO_WAIT);
+    k_thread_name_set(&sampler_thread, "sampler");
+}
+
+void pipeline_get_stats(struct pipeline_stats *out)
+{
+    *out = stats;
+    out->depth = k_msgq_num_used_get(&sample_q);
+
+#if defined(CONFIG_INIT_STACKS) && defined(CONFIG_THREAD_STACK_INFO)
+    size_t unused;
+    if (k_thread_stack_space_get(&sampler_thread, &unused) == 0) {
+        out->sampler_stack_unused = unused;
+    }
+    if (k_thread_stack_space_get(&uplink_thread, &unused) == 0) {
+        out->uplink_stack_unused = unused;
+    }
+#endif
+}
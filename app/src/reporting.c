@@ -0,0 +1,113 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "reporting.h"
+#include "wind_math.h"
+
+/* Last sample sent for each station */
+static struct {
+    struct ws_sample sample;
+    bool valid;
+} last[WS_NUM_STATIONS];
+
+/* Thresholds, changed at runtime from the shell */
+static struct k_spinlock lock;
+static struct reporting_params params = {
+    .speed_deadband = CONFIG_WEATHER_STATION_REPORT_SPEED_DEADBAND,
+    .direction_deadband = CONFIG_WEATHER_STATION_REPORT_DIRECTION_DEADBAND,
+    .gust = CONFIG_WEATHER_STATION_REPORT_GUST,
+    .shift = CONFIG_WEATHER_STATION_REPORT_SHIFT,
+    .heartbeat_ms = CONFIG_WEATHER_STATION_REPORT_HEARTBEAT_MS,
+};
+
+/* Written by the sampling thread only */
+static struct reporting_stats stats;
+
+/**
+ * @brief Classify a sample against the last one sent for its station.
+ *
+ * Directions are only compared when both are known; a direction becoming known or unknown
+ * is a change.
+ */
+static enum reporting_decision classify(const struct reporting_params *p,
+                                        const struct ws_sample *prev,
+                                        const struct ws_sample *sample)
+{
+    int32_t rise = (int32_t)sample->wind_speed - (int32_t)prev->wind_speed;
+    bool prev_known = prev->wind_direction >= 0;
+    bool known = sample->wind_direction >= 0;
+    int32_t turn = prev_known && known ?
+                   wm_angle_diff_ddeg(sample->wind_direction, prev->wind_direction) : 0;
+
+    if (p->gust > 0 && rise >= (int32_t)p->gust) {
+        stats.gusts++;
+        return REPORTING_SEND_NOW;
+    }
+    if (p->shift > 0 && turn >= (int32_t)p->shift) {
+        stats.shifts++;
+        return REPORTING_SEND_NOW;
+    }
+    if ((uint32_t)abs(rise) >= p->speed_deadband || turn >= (int32_t)p->direction_deadband ||
+        prev_known != known) {
+        stats.changes++;
+        return REPORTING_SEND;
+    }
+    if (sample->timestamp - prev->timestamp >= p->heartbeat_ms) {
+        stats.heartbeats++;
+        return REPORTING_SEND;
+    }
+    stats.suppressed++;
+    return REPORTING_SUPPRESS;
+}
+
+enum reporting_decision reporting_check(size_t station, const struct ws_sample *sample)
+{
+    struct reporting_params p;
+    enum reporting_decision decision;
+
+    reporting_get_params(&p);
+    stats.samples++;
+
+    if (!last[station].valid) {
+        stats.changes++;
+        decision = REPORTING_SEND;
+    } else {
+        decision = classify(&p, &last[station].sample, sample);
+    }
+
+    if (decision != REPORTING_SUPPRESS) {
+        last[station].sample = *sample;
+        last[station].valid = true;
+    }
+    return decision;
+}
+
+void reporting_get_params(struct reporting_params *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    *out = params;
+    k_spin_unlock(&lock, key);
+}
+
+int reporting_set_params(const struct reporting_params *new_params)
+{
+    if (new_params->direction_deadband > 1800 || new_params->shift > 1800 ||
+        new_params->heartbeat_ms == 0) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    params = *new_params;
+    k_spin_unlock(&lock, key);
+    return 0;
+}
+
+void reporting_get_stats(struct reporting_stats *out)
+{
+    *out = stats;
+}
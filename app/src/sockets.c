@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+ #include <zephyr/kernel.h>
  #include <zephyr/logging/log.h>
  #include <zephyr/net/net_ip.h>
  #include <zephyr/net/socket.h>
@@ -17,62 +18,88 @@
  #include "ca_certificate.h"
  #endif
 
+ #include <errno.h>
+ #include <string.h>
+
+ #include "dns_cache.h"
+ #include "log_dedup.h"
  #include "sockets.h"
- 
-#define HTTP_HOST "csse4011-iot.uqcloud.net"
+ #include "wire.h"
+
+LOG_MODULE_REGISTER(uplink_http, CONFIG_WEATHER_STATION_LOG_LEVEL);
+
+#define HTTP_HOST CONFIG_HTTP_HOST
 #define HTTP_PATH "/"
+#define HTTP_PORT STRINGIFY(CONFIG_HTTP_PORT)
+
+/* Failures of the socket operations, see log_failure() */
+static struct log_dedup failures;
+
+/**
+ * @brief Log a failed socket operation, folding repeats.
+ *
+ * @param op  Name of the failed operation, a string literal.
+ * @param err Negative error code.
+ */
+static void log_failure(const char *op, int err)
+{
+    LOG_DEDUP_FAILURE(&failures, op, err);
+}
+
+/**
+ * @brief Note a successful request, ending any run of failures.
+ */
+static void log_success(void)
+{
+    LOG_DEDUP_SUCCESS(&failures);
+}
+
+/* Connection reuse: the server keeps HTTP/1.1 connections open between samples */
+static struct {
+    int sock;
+} session = { .sock = -1 };
+
+/**
+ * @brief Register the server's CA certificate, once for all connections.
+ */
+static int http_init(void)
+{
 #if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
-#define HTTP_PORT "443"
-#else
-#define HTTP_PORT "80"
+    int ret = tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
+                                 ca_certificate, sizeof(ca_certificate));
+    if (ret < 0 && ret != -EEXIST) {
+        LOG_ERR("op=tls_credential_add err=%d", ret);
+        return ret;
+    }
 #endif
+    return 0;
+}
 
 /**
- * @brief Sends an HTTP GET request with a dynamic URL.
- *
- * This function constructs a dynamic URL using the provided wind speed and wind direction values,
- * resolves the server hostname, and establishes a connection (with TLS if configured). It then
- * sends an HTTP GET request to the server with the URL parameters and closes the socket.
+ * @brief Open the persistent uplink connection.
  *
- * @param wind_speed    The measured wind speed.
- * @param wind_direction The measured wind direction.
+ * Looks up the server address in the DNS cache and establishes a connection (with TLS if configured).
  *
  * @return int Returns 0 on success, or a negative error code on failure.
  */
-int http_get_dynamic(float wind_speed, float wind_direction)
+static int session_connect(void)
 {
     int ret;
-    struct addrinfo hints = {0}, *res = NULL;
+    struct sockaddr_in addr;
     int sock;
 
-    /* Build the dynamic URL */
-    char dynamic_path[100];
-    ret = snprintk(dynamic_path, sizeof(dynamic_path),
-                   "/add.php?stationid=4011&speed=%.2f&direction=%.2f",
-                   (double)wind_speed, (double)wind_direction);
-    if (ret <= 0 || ret >= sizeof(dynamic_path)) {
-        printk("Error: Could not build dynamic URL.\n");
-        return -1;
-    }
-
-    printk("Sending GET request to https://%s%s\n", HTTP_HOST, dynamic_path);
-
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    ret = getaddrinfo(HTTP_HOST, HTTP_PORT, &hints, &res);
-    if (ret != 0) {
-        printk("Error: getaddrinfo() failed (%d)\n", ret);
-        return -1;
+    ret = dns_cache_lookup(HTTP_HOST, HTTP_PORT, &addr);
+    if (ret < 0) {
+        return ret;
     }
 
 #if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
-    sock = socket(res->ai_family, res->ai_socktype, IPPROTO_TLS_1_2);
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TLS_1_2);
 #else
-    sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 #endif
     if (sock < 0) {
-        printk("Error: socket() failed (%d)\n", sock);
-        freeaddrinfo(res);
+        log_failure("socket", -errno);
         return -1;
     }
 
@@ -81,68 +108,447 @@ int http_get_dynamic(float wind_speed, float wind_direction)
         sec_tag_t sec_tag_opt[] = { CA_CERTIFICATE_TAG };
         ret = setsockopt(sock, SOL_TLS, TLS_SEC_TAG_LIST, sec_tag_opt, sizeof(sec_tag_opt));
         if (ret < 0) {
-            printk("Error: setsockopt TLS_SEC_TAG_LIST: %d\n", ret);
+            log_failure("tls_sec_tag_list", -errno);
             close(sock);
-            freeaddrinfo(res);
             return ret;
         }
         ret = setsockopt(sock, SOL_TLS, TLS_HOSTNAME, HTTP_HOST, strlen(HTTP_HOST));
         if (ret < 0) {
-            printk("Error: setsockopt TLS_HOSTNAME: %d\n", ret);
+            log_failure("tls_hostname", -errno);
             close(sock);
-            freeaddrinfo(res);
             return ret;
         }
     }
 #endif
 
-    ret = connect(sock, res->ai_addr, res->ai_addrlen);
+#if defined(CONFIG_HTTP_TLS_SESSION_CACHE)
+    {
+        /* Resume the session of the previous connection to this server, if cached */
+        int cache = TLS_SESSION_CACHE_ENABLED;
+        ret = setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE, &cache, sizeof(cache));
+        if (ret < 0) {
+            log_failure("tls_session_cache", -errno);
+        }
+    }
+#endif
+
+    /* With TLS, connect() includes the handshake */
+    int64_t start = k_uptime_ticks();
+    ret = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
     if (ret < 0) {
-        printk("Error: connect() failed (%d)\n", ret);
+        log_failure("connect", -errno);
         close(sock);
-        freeaddrinfo(res);
         return ret;
     }
-    freeaddrinfo(res);
-
-    /* Build the HTTP GET request with the dynamic URL */
-    char req_buf[512];
-    int req_len = snprintk(req_buf, sizeof(req_buf),
-                           "GET %s HTTP/1.1\r\n"
-                           "Host: %s\r\n"
-                           "Connection: close\r\n"
-                           "\r\n",
-                           dynamic_path, HTTP_HOST);
-    if (req_len <= 0 || req_len >= sizeof(req_buf)) {
-        printk("Error: Request buffer too small or snprintk error\n");
-        close(sock);
+
+    session.sock = sock;
+    uplink_record_connect(start);
+    return 0;
+}
+
+/**
+ * @brief Close the persistent uplink connection, if open.
+ */
+static void session_close(void)
+{
+    if (session.sock >= 0) {
+        close(session.sock);
+        session.sock = -1;
+        LOG_DBG("Socket closed");
+    }
+}
+
+/**
+ * @brief Check whether the open connection is still usable.
+ *
+ * Discards any responses the server has sent since the last request without
+ * blocking, and detects a connection closed (EOF) or reset by the peer.
+ *
+ * @return true if the connection can carry another request.
+ */
+static bool session_alive(void)
+{
+    char discard[64];
+    ssize_t len;
+
+    do {
+        len = recv(session.sock, discard, sizeof(discard), MSG_DONTWAIT);
+    } while (len > 0);
+
+    if (len == 0) {
+        /* Server closed the connection */
+        return false;
+    }
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+/* Most fragments in one request */
+#define REQUEST_IOV_MAX 5
+
+/**
+ * @brief Send a complete request over the open connection.
+ *
+ * The fragments are gathered by sendmsg(), so they are never copied into one buffer.
+ *
+ * @param frags Request fragments, in order.
+ * @param count Number of fragments, at most REQUEST_IOV_MAX.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int session_send(const struct iovec *frags, size_t count)
+{
+    /* Partial sends advance this copy, so a retry can start again from @p frags */
+    struct iovec iov[REQUEST_IOV_MAX];
+    struct msghdr msg = { .msg_iov = iov, .msg_iovlen = count };
+
+    memcpy(iov, frags, count * sizeof(iov[0]));
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t ret = sendmsg(session.sock, &msg, 0);
+        if (ret < 0) {
+            return -errno;
+        }
+        uplink_stats.bytes_sent += ret;
+
+        while (msg.msg_iovlen > 0 && ret >= (ssize_t)msg.msg_iov->iov_len) {
+            ret -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + ret;
+            msg.msg_iov->iov_len -= ret;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Send a request over the persistent connection.
+ *
+ * Opens the connection if needed. If the server has closed or reset an idle
+ * connection, it is re-established and the request is retried once.
+ *
+ * @param frags Request fragments: request line, headers and body, in order.
+ * @param count Number of fragments, at most REQUEST_IOV_MAX.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int session_request(const struct iovec *frags, size_t count)
+{
+    int ret = -ENOTCONN;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (session.sock >= 0 && !session_alive()) {
+            session_close();
+            uplink_stats.reconnects++;
+        }
+        if (session.sock < 0) {
+            ret = session_connect();
+            if (ret < 0) {
+                return ret;
+            }
+        }
+
+        ret = session_send(frags, count);
+        if (ret == 0) {
+            log_success();
+            return 0;
+        }
+        log_failure("send", ret);
+        session_close();
+        uplink_stats.reconnects++;
+    }
+    return ret;
+}
+
+/* Constant request fragments, sent as they are */
+#define IOV_CONST(str) { .iov_base = (void *)(str), .iov_len = sizeof(str) - 1 }
+
+static const char get_line[] = "GET /add.php?stationid=";
+static const char get_headers[] = " HTTP/1.1\r\n"
+                                  "Host: " HTTP_HOST "\r\n"
+                                  "Connection: keep-alive\r\n"
+                                  "\r\n";
+
+/* Bulk uploads are packed frames (wire.h) or CSV records */
+#if defined(CONFIG_UPLINK_PACKED)
+#define POST_CONTENT_TYPE "application/octet-stream"
+#else
+#define POST_CONTENT_TYPE "text/csv"
+#endif
+
+static const char post_line[] = "POST " CONFIG_HTTP_POST_PATH " HTTP/1.1\r\n"
+                                "Host: " HTTP_HOST "\r\n"
+                                "Content-Type: " POST_CONTENT_TYPE "\r\n"
+                                "Content-Length: ";
+static const char post_headers[] = "\r\n"
+                                   "Connection: keep-alive\r\n"
+                                   "\r\n";
+
+/* Longest GET query values: "<station>&speed=<speed>&direction=<direction>" */
+#define GET_QUERY_MAX 48
+
+/* Formatted part of the GET request being sent */
+static char get_query[GET_QUERY_MAX];
+
+/**
+ * @brief Sends an HTTP GET request with a dynamic URL.
+ *
+ * This function constructs a dynamic URL using the provided station id, wind speed and wind
+ * direction values and sends it as an HTTP GET request over the persistent keep-alive connection, connecting
+ * (with TLS if configured) on first use or after the server has dropped the connection.
+ *
+ * @param station       The id of the station that took the measurement.
+ * @param wind_speed    The measured wind speed in 0.01 kph.
+ * @param wind_direction The measured wind direction in 0.1 degrees, negative if unknown.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+int http_get_dynamic(uint16_t station, uint32_t wind_speed, int32_t wind_direction)
+{
+    int ret;
+    int64_t start = k_uptime_ticks();
+
+    /* Only the values are formatted; the rest of the request is constant */
+    ret = snprintk(get_query, sizeof(get_query),
+                   "%u&speed=" WS_SPEED_FMT "&direction=" WS_DIRECTION_FMT,
+                   station, WS_SPEED_ARGS(wind_speed), WS_DIRECTION_ARGS(wind_direction));
+    if (ret <= 0 || ret >= sizeof(get_query)) {
+        LOG_ERR("op=format_get err=%d", -ENOMEM);
         return -1;
     }
+    uplink_stats.bytes_formatted += ret;
+
+    LOG_DBG("GET /add.php?stationid=%s", get_query);
+
+    const struct iovec frags[] = {
+        IOV_CONST(get_line),
+        { .iov_base = get_query, .iov_len = ret },
+        IOV_CONST(get_headers),
+    };
+
+    /* Responses are discarded unread before the next request is sent */
+    ret = session_request(frags, ARRAY_SIZE(frags));
+    if (ret < 0) {
+        uplink_stats.failures++;
+        return ret;
+    }
+
+    uplink_record_request(start, 1);
+    return 0;
+}
+
+/* Longest CSV record: "<station>,<boot>,<uptime ms>,<speed>,<direction>\n" */
+#define POST_RECORD_MAX 62
+
+/* Body of the bulk upload being sent, as CSV records or a packed frame */
+static char post_body[CONFIG_UPLINK_BULK_MAX_SAMPLES * POST_RECORD_MAX];
+
+BUILD_ASSERT(sizeof(post_body) >= WIRE_PACKED_FRAME_SIZE(CONFIG_UPLINK_BULK_MAX_SAMPLES),
+             "bulk upload buffer too small for a packed frame");
+
+/**
+ * @brief Format the body of a bulk upload into post_body.
+ *
+ * @return int Returns the body length, or -ENOMEM if it does not fit.
+ */
+static int format_post_body(const struct ws_sample *samples, size_t count)
+{
+#if defined(CONFIG_UPLINK_PACKED)
+    return wire_encode_packed((uint8_t *)post_body, sizeof(post_body), samples, count);
+#else
+    size_t body_len = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int ret = snprintk(post_body + body_len, sizeof(post_body) - body_len,
+                           "%u,%u,%lld," WS_SPEED_FMT "," WS_DIRECTION_FMT "\n",
+                           samples[i].station, samples[i].boot,
+                           (long long)samples[i].timestamp,
+                           WS_SPEED_ARGS(samples[i].wind_speed),
+                           WS_DIRECTION_ARGS(samples[i].wind_direction));
+        if (ret <= 0 || ret >= sizeof(post_body) - body_len) {
+            return -ENOMEM;
+        }
+        body_len += ret;
+    }
+    return body_len;
+#endif
+}
+
+int http_post_samples(const struct ws_sample *samples, size_t count)
+{
+    int ret;
+    int64_t start = k_uptime_ticks();
+    size_t body_len;
+
+    if (count == 0) {
+        return 0;
+    }
+    if (count > CONFIG_UPLINK_BULK_MAX_SAMPLES) {
+        return -EINVAL;
+    }
 
-    ret = send(sock, req_buf, req_len, 0);
+    ret = format_post_body(samples, count);
     if (ret < 0) {
-        printk("Error: send() failed (%d)\n", ret);
+        LOG_ERR("op=format_post err=%d", ret);
+        return ret;
+    }
+    body_len = ret;
+
+    /* Content-Length is the only formatted header */
+    static char post_length[12];
+    int length_len = snprintk(post_length, sizeof(post_length), "%u", (unsigned int)body_len);
+    uplink_stats.bytes_formatted += body_len + length_len;
+
+    LOG_DBG("POST %u samples to " CONFIG_HTTP_POST_PATH, (unsigned int)count);
+
+    const struct iovec frags[] = {
+        IOV_CONST(post_line),
+        { .iov_base = post_length, .iov_len = length_len },
+        IOV_CONST(post_headers),
+        { .iov_base = post_body, .iov_len = body_len },
+    };
+
+    ret = session_request(frags, ARRAY_SIZE(frags));
+    if (ret < 0) {
+        uplink_stats.failures++;
+        return ret;
+    }
+
+    uplink_record_request(start, count);
+    return 0;
+}
+
+#if defined(CONFIG_UPLINK_BINARY)
+/* Connected datagram socket for binary frames */
+static int udp_sock = -1;
+
+/* Frame being sent */
+#if defined(CONFIG_UPLINK_PACKED)
+static uint8_t frame_buf[WIRE_PACKED_FRAME_SIZE(CONFIG_UPLINK_BULK_MAX_SAMPLES)];
+#define FRAME_ENCODE wire_encode_packed
+#else
+static uint8_t frame_buf[WIRE_FRAME_SIZE(CONFIG_UPLINK_BULK_MAX_SAMPLES)];
+#define FRAME_ENCODE wire_encode
+#endif
+
+/**
+ * @brief Open the datagram socket for binary frames.
+ *
+ * @return int Returns 0 on success, or a negative error code on failure.
+ */
+static int udp_open(void)
+{
+    struct sockaddr_in addr;
+    int ret;
+    int sock;
+
+    ret = dns_cache_lookup(HTTP_HOST, HTTP_PORT, &addr);
+    if (ret < 0) {
+        return ret;
+    }
+    addr.sin_port = htons(CONFIG_UPLINK_BINARY_PORT);
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        log_failure("socket", -errno);
+        return -1;
+    }
+
+    int64_t start = k_uptime_ticks();
+    ret = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+    if (ret < 0) {
+        log_failure("connect", -errno);
         close(sock);
         return ret;
     }
 
-    /* Receive and print the server response */
-    // adds latency, by-pass this for now.
-    // char response[512];
-    // while (1) {
-    //     ret = recv(sock, response, sizeof(response) - 1, 0);
-    //     if (ret < 0) {
-    //         printk("Error: recv() failed (%d)\n", ret);
-    //         break;
-    //     }
-    //     if (ret == 0) {
-    //         /* Server closed connection */
-    //         break;
-    //     }
-    //     response[ret] = '\0';
-    //     printk("%s", response);
-    // }
-    close(sock);
-    printk("\nSocket closed.\n");
+    udp_sock = sock;
+    uplink_record_connect(start);
     return 0;
 }
+
+int udp_send_samples(const struct ws_sample *samples, size_t count)
+{
+    int ret;
+    int64_t start = k_uptime_ticks();
+
+    if (count > CONFIG_UPLINK_BULK_MAX_SAMPLES) {
+        return -EINVAL;
+    }
+
+    int len = FRAME_ENCODE(frame_buf, sizeof(frame_buf), samples, count);
+    if (len < 0) {
+        LOG_ERR("op=wire_encode err=%d", len);
+        return len;
+    }
+    uplink_stats.bytes_formatted += len;
+
+    if (udp_sock < 0) {
+        ret = udp_open();
+        if (ret < 0) {
+            uplink_stats.failures++;
+            return ret;
+        }
+    }
+
+    if (send(udp_sock, frame_buf, len, 0) < 0) {
+        ret = -errno;
+        log_failure("udp_send", ret);
+        close(udp_sock);
+        udp_sock = -1;
+        uplink_stats.failures++;
+        return ret;
+    }
+
+    log_success();
+    uplink_stats.bytes_sent += len;
+    uplink_record_request(start, count);
+    return 0;
+}
+#endif /* CONFIG_UPLINK_BINARY */
+
+/**
+ * @brief Send one sample with a GET request.
+ */
+static int http_send(const struct ws_sample *sample)
+{
+    return http_get_dynamic(sample->station, sample->wind_speed, sample->wind_direction);
+}
+
+const struct uplink_transport http_transport = {
+    .name = "http",
+    .init = http_init,
+    .send = http_send,
+    .send_samples = http_post_samples,
+    .close = session_close,
+};
+
+#if defined(CONFIG_UPLINK_BINARY)
+/**
+ * @brief Send one sample in its own frame.
+ */
+static int udp_send(const struct ws_sample *sample)
+{
+    return udp_send_samples(sample, 1);
+}
+
+/**
+ * @brief Close the datagram socket, if open.
+ */
+static void udp_close(void)
+{
+    if (udp_sock >= 0) {
+        close(udp_sock);
+        udp_sock = -1;
+    }
+}
+
+const struct uplink_transport udp_transport = {
+    .name = "udp",
+    .send = udp_send,
+    .send_samples = udp_send_samples,
+    .close = udp_close,
+};
+#endif /* CONFIG_UPLINK_BINARY */
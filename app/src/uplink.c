@@ -0,0 +1,148 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+
+#include "uplink.h"
+
+#if defined(CONFIG_UPLINK_MQTT)
+#define TRANSPORT (&mqtt_transport)
+#elif defined(CONFIG_UPLINK_COAP)
+#define TRANSPORT (&coap_transport)
+#elif defined(CONFIG_UPLINK_BINARY)
+#define TRANSPORT (&udp_transport)
+#else
+#define TRANSPORT (&http_transport)
+#endif
+
+struct uplink_stats uplink_stats;
+struct latency_hist uplink_connect_hist;
+struct latency_hist uplink_request_hist;
+
+int uplink_init(void)
+{
+    if (TRANSPORT->init == NULL) {
+        return 0;
+    }
+    return TRANSPORT->init();
+}
+
+int uplink_send(const struct ws_sample *sample)
+{
+    return TRANSPORT->send(sample);
+}
+
+int uplink_send_samples(const struct ws_sample *samples, size_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+    if (count > CONFIG_UPLINK_BULK_MAX_SAMPLES) {
+        return -EINVAL;
+    }
+    for (size_t i = 1; i < count; i++) {
+        if (samples[i].boot != samples[0].boot) {
+            /* Frames carry one boot number for all their uptimes */
+            return -EINVAL;
+        }
+    }
+    return TRANSPORT->send_samples(samples, count);
+}
+
+void uplink_close(void)
+{
+    TRANSPORT->close();
+}
+
+void uplink_get_stats(struct uplink_stats *out)
+{
+    *out = uplink_stats;
+}
+
+void uplink_record_connect(int64_t start)
+{
+    uint32_t us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks() - start);
+
+    latency_hist_record(&uplink_connect_hist, us);
+    uplink_stats.connects++;
+    uplink_stats.connect_last_us = us;
+    uplink_stats.connect_total_us += us;
+    if (us > uplink_stats.connect_max_us) {
+        uplink_stats.connect_max_us = us;
+    }
+}
+
+void uplink_record_request(int64_t start, uint32_t samples)
+{
+    uint32_t us = (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks() - start);
+
+    latency_hist_record(&uplink_request_hist, us);
+    uplink_stats.requests++;
+    uplink_stats.samples += samples;
+    uplink_stats.last_us = us;
+    uplink_stats.total_us += us;
+    if (uplink_stats.requests == 1 || us < uplink_stats.min_us) {
+        uplink_stats.min_us = us;
+    }
+    if (us > uplink_stats.max_us) {
+        uplink_stats.max_us = us;
+    }
+}
+
+#if defined(CONFIG_UPLINK_BATCH)
+/* Samples queued for the next batched upload, oldest first */
+static struct {
+    struct ws_sample samples[CONFIG_UPLINK_BULK_MAX_SAMPLES];
+    uint32_t count;
+    int64_t due; /* Uptime (ms) when the queued samples are to be sent */
+    uplink_batch_sent_t sent;
+} batch;
+
+void uplink_batch_set_callback(uplink_batch_sent_t sent)
+{
+    batch.sent = sent;
+}
+
+int uplink_batch_add(const struct ws_sample *sample)
+{
+    if (batch.count == ARRAY_SIZE(batch.samples) && uplink_batch_flush() < 0) {
+        /* Still undeliverable: the caller keeps the sample */
+        return -EAGAIN;
+    }
+
+    if (batch.count == 0) {
+        batch.due = sample->timestamp + CONFIG_UPLINK_BATCH_MAX_LINGER_MS;
+    }
+    batch.samples[batch.count++] = *sample;
+
+    if (batch.count >= CONFIG_UPLINK_BATCH_MAX_SAMPLES || k_uptime_get() >= batch.due) {
+        /* On failure the batch stays queued, see uplink_batch_flush() */
+        (void)uplink_batch_flush();
+    }
+    return 0;
+}
+
+int uplink_batch_flush(void)
+{
+    int ret = uplink_send_samples(batch.samples, batch.count);
+
+    if (ret == 0) {
+        if (batch.sent != NULL && batch.count > 0) {
+            batch.sent(batch.samples, batch.count);
+        }
+        batch.count = 0;
+    } else {
+        /* Retry a linger period later, or as soon as the batch fills up */
+        batch.due = k_uptime_get() + CONFIG_UPLINK_BATCH_MAX_LINGER_MS;
+    }
+    return ret;
+}
+
+int64_t uplink_batch_due(void)
+{
+    return batch.count > 0 ? batch.due : -1;
+}
+#endif /* CONFIG_UPLINK_BATCH */
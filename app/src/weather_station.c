@@ -6,11 +6,14 @@
  */
 
 #include <weather_station.h>
+#include <zephyr/sys/util.h>
+#include "wind_vane.h"
 #include <zephyr/device.h>
 #include <zephyr/sys/printk.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
 
 /*----------------------------------------------------------------------------
  * Macros and Calibration Constants
@@ -36,15 +39,11 @@
 #define SFE_WMK_ADC_ANGLE_337_5 398 
 
 #define SFE_WMK_ADC_RESOLUTION          10  // 10-bit ADC resolution
-#define SFE_WIND_VANE_DEGREES_PER_INDEX 22.5f
+#define SFE_WIND_VANE_DECIDEGREES_PER_INDEX 225
 
-/*----------------------------------------------------------------------------
- * Global Instance Pointer for Interrupt Context
- *----------------------------------------------------------------------------
- * For simplicity (and because typical ISRs cannot have a context pointer),
- * we use a global pointer to the one active kit instance.
- */
-static SFEWeatherMeterKit *kit_instance = NULL;
+BUILD_ASSERT(IS_POWER_OF_TWO(SFE_WMK_PULSE_RING_SIZE), "pulse ring size must be a power of two");
+
+struct latency_hist weather_station_adc_hist;
 
 /*----------------------------------------------------------------------------
  * Forward Declarations for Callbacks
@@ -53,16 +52,19 @@ static SFEWeatherMeterKit *kit_instance = NULL;
 static void wind_speed_callback(const struct device *dev,
                                 struct gpio_callback *cb,
                                 uint32_t pins);
+static void buildVaneLUT(SFEWeatherMeterKit *kit);
 
 /*----------------------------------------------------------------------------
  * ADC Channel Configuration Helper
  *----------------------------------------------------------------------------
- * Configures the ADC channel used by the wind direction sensor.
+ * Configures the ADC channel used by the wind direction sensor with the
+ * driver's defaults. Stations whose channel is described in the devicetree
+ * are set up from it instead, see weather_station_init().
  */
 static int configure_adc_channel(SFEWeatherMeterKit *kit)
 {
     struct adc_channel_cfg channel_cfg = {
-        .gain             = ADC_GAIN_1_4,
+        .gain             = SFE_WMK_ADC_GAIN,
         .reference        = ADC_REF_INTERNAL,
         .acquisition_time = ADC_ACQ_TIME_DEFAULT,
         .channel_id       = kit->wind_dir_adc_channel,
@@ -96,6 +98,7 @@ void SFEWeatherMeterKit_init(SFEWeatherMeterKit *kit,
     /* Save device pointers and pin numbers */
     kit->adc_dev = adc_dev;
     kit->wind_dir_adc_channel = wind_dir_adc_channel;
+    kit->wind_dir_adc_gain = SFE_WMK_ADC_GAIN;
     kit->gpio_dev = gpio_dev;
     kit->wind_speed_pin = wind_speed_pin;
 
@@ -125,14 +128,16 @@ void SFEWeatherMeterKit_init(SFEWeatherMeterKit *kit,
     /* Set other calibration parameters */
     kit->calibrationParams.kphPerCountPerSec = 2.4f;
     kit->calibrationParams.windSpeedMeasurementPeriodMillis = 1000;
+    kit->centiKphPerCountPerSec = 240;
+    kit->adcResolutionBits = SFE_WMK_ADC_RESOLUTION;
+    buildVaneLUT(kit);
 
     /* Reset counters and timers using Zephyr’s uptime (milliseconds) */
-    kit->windCountsPrevious = 0;
-    kit->windCounts = 0;
-    kit->lastWindSpeedMillis = k_uptime_get_32();
-
-    /* Save this instance for use in the interrupt callback */
-    kit_instance = kit;
+    atomic_set(&kit->pulseHead, 0);
+    memset(kit->pulseStamps, 0, sizeof(kit->pulseStamps));
+    memset(kit->pulseCycles, 0, sizeof(kit->pulseCycles));
+    SFEWeatherMeterKit_setWindSpeedMode(kit, SFE_WMK_SPEED_WINDOW, 0);
+    SFEWeatherMeterKit_resetWindSpeedFilter(kit);
 }
 
 /*----------------------------------------------------------------------------
@@ -164,6 +169,7 @@ int SFEWeatherMeterKit_begin(SFEWeatherMeterKit *kit)
     ret = gpio_pin_interrupt_configure(kit->gpio_dev, kit->wind_speed_pin, GPIO_INT_EDGE_BOTH);
     if (ret < 0) {
         printk("Error configuring wind speed interrupt\n");
+        gpio_remove_callback(kit->gpio_dev, &kit->wind_speed_cb);
         return ret;
     }
 
@@ -179,100 +185,314 @@ SFEWeatherMeterKitCalibrationParams SFEWeatherMeterKit_getCalibrationParams(SFEW
     return kit->calibrationParams;
 }
 
+/*
+ * Rebuild the wind vane decode table. Each bucket of ADC codes maps to the
+ * calibration value closest to the middle of the bucket, if that is within
+ * the tolerance, so decoding a reading is a single table lookup.
+ */
+static void buildVaneLUT(SFEWeatherMeterKit *kit)
+{
+    uint8_t shift = 0;
+    if (kit->adcResolutionBits > SFE_WMK_VANE_LUT_BITS) {
+        shift = kit->adcResolutionBits - SFE_WMK_VANE_LUT_BITS;
+    }
+    int32_t tolerance = SFE_WMK_VANE_TOLERANCE;
+    if (kit->adcResolutionBits > SFE_WMK_ADC_RESOLUTION) {
+        tolerance <<= kit->adcResolutionBits - SFE_WMK_ADC_RESOLUTION;
+    } else {
+        tolerance >>= SFE_WMK_ADC_RESOLUTION - kit->adcResolutionBits;
+    }
+    uint32_t buckets = BIT(kit->adcResolutionBits) >> shift;
+
+    kit->vaneLUTShift = shift;
+    memset(kit->vaneLUT, SFE_WMK_VANE_INVALID, sizeof(kit->vaneLUT));
+
+    for (uint32_t b = 0; b < buckets; b++) {
+        int32_t code = (b << shift) + (BIT(shift) >> 1);
+        int32_t closestDifference = tolerance;
+        for (uint8_t i = 0; i < WMK_NUM_ANGLES; i++) {
+            int32_t diff = abs((int32_t)kit->calibrationParams.vaneADCValues[i] - code);
+            if (diff < closestDifference) {
+                closestDifference = diff;
+                kit->vaneLUT[b] = i;
+            }
+        }
+    }
+}
+
 void SFEWeatherMeterKit_setCalibrationParams(SFEWeatherMeterKit *kit,
                                              SFEWeatherMeterKitCalibrationParams params)
 {
     memcpy(&kit->calibrationParams, &params, sizeof(SFEWeatherMeterKitCalibrationParams));
+
+    /* Convert once here so that speed readings need no floating point */
+    kit->centiKphPerCountPerSec = (uint32_t)(params.kphPerCountPerSec * 100.0f + 0.5f);
+    buildVaneLUT(kit);
 }
 
 void SFEWeatherMeterKit_setADCResolutionBits(SFEWeatherMeterKit *kit, uint8_t resolutionBits)
 {
+    int8_t bitShift = kit->adcResolutionBits - resolutionBits;
+
     for (uint8_t i = 0; i < WMK_NUM_ANGLES; i++) {
-        int8_t bitShift = SFE_WMK_ADC_RESOLUTION - resolutionBits;
         if (bitShift > 0) {
             kit->calibrationParams.vaneADCValues[i] >>= bitShift;
         } else if (bitShift < 0) {
             kit->calibrationParams.vaneADCValues[i] <<= (-bitShift);
         }
     }
+    kit->adcResolutionBits = resolutionBits;
+    buildVaneLUT(kit);
+}
+
+int SFEWeatherMeterKit_decodeVaneIndex(const SFEWeatherMeterKit *kit, int32_t rawADC)
+{
+    if (rawADC < 0 || rawADC >= (int32_t)BIT(kit->adcResolutionBits)) {
+        return -ERANGE;
+    }
+    uint8_t index = kit->vaneLUT[rawADC >> kit->vaneLUTShift];
+    return index == SFE_WMK_VANE_INVALID ? -ERANGE : index;
 }
 
 /*----------------------------------------------------------------------------
  * Wind Direction Measurement
  *----------------------------------------------------------------------------
- * Reads the wind direction sensor via the ADC, compares the reading against
- * calibration values, and returns the closest matching wind direction in degrees.
+ * Reads the wind direction sensor via the ADC, decodes the reading to the
+ * closest calibrated vane position, and returns its direction in tenths of a
+ * degree.
  */
-float SFEWeatherMeterKit_getWindDirection(SFEWeatherMeterKit *kit)
+int32_t SFEWeatherMeterKit_getWindDirectionDeciDegrees(SFEWeatherMeterKit *kit)
 {
-    int32_t rawADC = 0;
     int16_t sample_buffer = 0;
     struct adc_sequence sequence = {
         .channels    = BIT(kit->wind_dir_adc_channel),
         .buffer      = &sample_buffer,
         .buffer_size = sizeof(sample_buffer),
-        .resolution  = SFE_WMK_ADC_RESOLUTION,
+        .resolution  = kit->adcResolutionBits,
     };
 
-    if (adc_read(kit->adc_dev, &sequence) < 0) {
+    uint32_t start = k_cycle_get_32();
+    int ret = adc_read(kit->adc_dev, &sequence);
+    latency_hist_record_cycles(&weather_station_adc_hist, start);
+    if (ret < 0) {
         printk("ADC read error\n");
-        return -1.0f;
+        return ret;
     }
-    rawADC = (int32_t)sample_buffer;
 
-    int16_t closestDifference = 10;
-    uint8_t closestIndex = 0;
-    for (uint8_t i = 0; i < WMK_NUM_ANGLES; i++) {
-        int16_t diff = kit->calibrationParams.vaneADCValues[i] - rawADC;
-        diff = abs(diff);
-        if (diff < closestDifference) {
-            closestDifference = diff;
-            closestIndex = i;
-        }
+    int index = SFEWeatherMeterKit_decodeVaneIndex(kit, sample_buffer);
+    if (index < 0) {
+        return index;
     }
-    float direction = closestIndex * SFE_WIND_VANE_DEGREES_PER_INDEX;
-    return direction;
+    return index * SFE_WIND_VANE_DECIDEGREES_PER_INDEX;
+}
+
+float SFEWeatherMeterKit_getWindDirection(SFEWeatherMeterKit *kit)
+{
+    int32_t direction = SFEWeatherMeterKit_getWindDirectionDeciDegrees(kit);
+
+    return direction < 0 ? -1.0f : direction / 10.0f;
 }
 
 /*----------------------------------------------------------------------------
  * Wind Speed Measurement Update
  *----------------------------------------------------------------------------
- * Uses a fixed measurement window to update the wind speed counters.
+ * Uses a fixed measurement window to update the wind speed counters. Runs in
+ * thread context only: the count at a window boundary is recovered from the
+ * edge timestamps, so windows are exact however late this is called.
  */
+
+/* Number of edges counted up to and including time t (ms) */
+static uint32_t pulsesAt(const SFEWeatherMeterKit *kit, uint32_t head, uint32_t t)
+{
+    uint32_t n = head;
+
+    for (uint32_t i = 0; i < SFE_WMK_PULSE_RING_SIZE && n > 0; i++) {
+        uint32_t stamp = kit->pulseStamps[(n - 1) & (SFE_WMK_PULSE_RING_SIZE - 1)];
+        if ((int32_t)(stamp - t) <= 0) {
+            break;
+        }
+        n--;
+    }
+    return n;
+}
+
 static void updateWindSpeed(SFEWeatherMeterKit *kit)
 {
+    uint32_t period = kit->calibrationParams.windSpeedMeasurementPeriodMillis;
     uint32_t tNow = k_uptime_get_32();
+    uint32_t head = (uint32_t)atomic_get(&kit->pulseHead);
     uint32_t dt = tNow - kit->lastWindSpeedMillis;
 
-    if (dt < kit->calibrationParams.windSpeedMeasurementPeriodMillis) {
+    if (dt < period) {
         /* Still within the current measurement window */
+    } else if (dt >= period * 2) {
+        /* Not read for over two periods: report the period ending now */
+        kit->windCountsPrevious = head - pulsesAt(kit, head, tNow - period);
+        kit->windowStartCount = head;
+        kit->lastWindSpeedMillis = tNow;
     } else {
-        if (dt > (kit->calibrationParams.windSpeedMeasurementPeriodMillis * 2)) {
-            /* No pulses for over two periods: reset counters */
-            kit->windCountsPrevious = 0;
-            kit->windCounts = 0;
-            kit->lastWindSpeedMillis = tNow;
-        } else {
-            /* End of the measurement window: store the count and reset */
-            kit->windCountsPrevious = kit->windCounts;
-            kit->windCounts = 0;
-            kit->lastWindSpeedMillis += kit->calibrationParams.windSpeedMeasurementPeriodMillis;
-        }
+        /* End of the measurement window: store its count and start the next */
+        uint32_t windowEnd = kit->lastWindSpeedMillis + period;
+        uint32_t endCount = pulsesAt(kit, head, windowEnd);
+        kit->windCountsPrevious = endCount - kit->windowStartCount;
+        kit->windowStartCount = endCount;
+        kit->lastWindSpeedMillis = windowEnd;
     }
 }
 
 /*----------------------------------------------------------------------------
  * Get Wind Speed
  *----------------------------------------------------------------------------
- * Computes the wind speed in kph based on the counts recorded during the last
- * measurement window.
+ * Computes the wind speed in 0.01 kph based on the counts recorded during the
+ * last measurement window. Each revolution produces two counts (both edges).
  */
-float SFEWeatherMeterKit_getWindSpeed(SFEWeatherMeterKit *kit)
+static uint32_t windowSpeedCentiKph(SFEWeatherMeterKit *kit)
 {
     updateWindSpeed(kit);
-    float windSpeed = ((float) kit->windCountsPrevious / kit->calibrationParams.windSpeedMeasurementPeriodMillis)
-                      * 1000 * kit->calibrationParams.kphPerCountPerSec / 2;
-    return windSpeed;
+    uint64_t num = (uint64_t)kit->windCountsPrevious * 1000 * kit->centiKphPerCountPerSec;
+    uint32_t den = 2 * kit->calibrationParams.windSpeedMeasurementPeriodMillis;
+    return (uint32_t)((num + den / 2) / den);
+}
+
+/*----------------------------------------------------------------------------
+ * Pulse-Period Wind Speed Estimation
+ *----------------------------------------------------------------------------
+ * Estimates the switch closure period (two edges) from the cycle-counter
+ * timestamps of the most recent edges, filtered either as a moving average or
+ * an exponential moving average. A closure that is overdue stretches the
+ * estimate so the reading decays promptly when the wind drops.
+ *
+ * The 32-bit cycle counter wraps within seconds, so timeouts are judged on the
+ * millisecond stamps, and a closure that spans a timeout (the first one after
+ * a calm) is left out rather than measured in cycles.
+ */
+#define PULSE_MASK (SFE_WMK_PULSE_RING_SIZE - 1)
+
+/* True if the closure ending at edge i spans a timeout, so its cycle count is meaningless */
+static bool closureTimedOut(const SFEWeatherMeterKit *kit, uint32_t i)
+{
+    return kit->pulseStamps[i & PULSE_MASK] - kit->pulseStamps[(i - 2) & PULSE_MASK] >=
+           SFE_WMK_PERIOD_TIMEOUT_MS;
+}
+
+/* Fold the closure periods of edges received since the last call into the EMA */
+static void updatePeriodEma(SFEWeatherMeterKit *kit, uint32_t head)
+{
+    uint32_t first = kit->periodLastIndex + 1;
+
+    /* Skip edges that have already left the ring */
+    if (head - first > SFE_WMK_PULSE_RING_SIZE - 2) {
+        first = head - (SFE_WMK_PULSE_RING_SIZE - 2);
+        kit->periodEma = 0;
+    }
+
+    for (uint32_t i = first; i != head; i++) {
+        if (i < 2 || closureTimedOut(kit, i)) {
+            continue;
+        }
+        uint64_t period = (uint64_t)(kit->pulseCycles[i & PULSE_MASK] -
+                                     kit->pulseCycles[(i - 2) & PULSE_MASK]) << 4;
+        if (kit->periodEma == 0) {
+            kit->periodEma = period;
+        } else if (period >= kit->periodEma) {
+            kit->periodEma += (period - kit->periodEma) >> kit->speedFilterParam;
+        } else {
+            kit->periodEma -= (kit->periodEma - period) >> kit->speedFilterParam;
+        }
+    }
+    kit->periodLastIndex = head - 1;
+}
+
+static uint32_t periodSpeedCentiKph(SFEWeatherMeterKit *kit)
+{
+    uint32_t head = (uint32_t)atomic_get(&kit->pulseHead);
+    uint32_t nowMs = k_uptime_get_32();
+    uint32_t now = k_cycle_get_32();
+    uint64_t period;
+
+    if (head < 3) {
+        return 0;
+    }
+
+    if (nowMs - kit->pulseStamps[(head - 1) & PULSE_MASK] >= SFE_WMK_PERIOD_TIMEOUT_MS) {
+        kit->periodEma = 0;
+        kit->periodLastIndex = head - 1;
+        return 0;
+    }
+    /* Within the timeout, which is well short of a cycle counter wrap */
+    uint32_t age = now - kit->pulseCycles[(head - 1) & PULSE_MASK];
+
+    if (kit->speedMode == SFE_WMK_SPEED_PERIOD_EMA) {
+        updatePeriodEma(kit, head);
+        if (kit->periodEma == 0) {
+            /* No closure measured since the last timeout yet */
+            return 0;
+        }
+        period = kit->periodEma >> 4;
+    } else {
+        /* Average the latest closures, back to the first one that spans a timeout */
+        uint32_t n = 0;
+        while (n < MIN(kit->speedFilterParam, (head - 1) / 2) &&
+               !closureTimedOut(kit, head - 1 - 2 * n)) {
+            n++;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        uint32_t span = kit->pulseCycles[(head - 1) & PULSE_MASK] -
+                        kit->pulseCycles[(head - 1 - 2 * n) & PULSE_MASK];
+        period = span / n;
+    }
+
+    /* The next closure is at least as far away as the last edge */
+    period = MAX(period, (uint64_t)age);
+    if (period == 0) {
+        return 0;
+    }
+
+    uint64_t num = (uint64_t)kit->centiKphPerCountPerSec * sys_clock_hw_cycles_per_sec();
+    return (uint32_t)((num + period / 2) / period);
+}
+
+int SFEWeatherMeterKit_setWindSpeedMode(SFEWeatherMeterKit *kit,
+                                        SFEWeatherMeterKitSpeedMode mode,
+                                        uint8_t filterParam)
+{
+    switch (mode) {
+    case SFE_WMK_SPEED_WINDOW:
+        break;
+    case SFE_WMK_SPEED_PERIOD_AVG:
+        if (filterParam < 1 || filterParam >= SFE_WMK_PULSE_RING_SIZE / 2) {
+            return -EINVAL;
+        }
+        break;
+    case SFE_WMK_SPEED_PERIOD_EMA:
+        if (filterParam > 15) {
+            return -EINVAL;
+        }
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    kit->speedMode = mode;
+    kit->speedFilterParam = filterParam;
+    kit->periodEma = 0;
+    kit->periodLastIndex = (uint32_t)atomic_get(&kit->pulseHead) - 1;
+    return 0;
+}
+
+uint32_t SFEWeatherMeterKit_getWindSpeedCentiKph(SFEWeatherMeterKit *kit)
+{
+    if (kit->speedMode == SFE_WMK_SPEED_WINDOW) {
+        return windowSpeedCentiKph(kit);
+    }
+    return periodSpeedCentiKph(kit);
+}
+
+float SFEWeatherMeterKit_getWindSpeed(SFEWeatherMeterKit *kit)
+{
+    return SFEWeatherMeterKit_getWindSpeedCentiKph(kit) / 100.0f;
 }
 
 /*----------------------------------------------------------------------------
@@ -281,13 +501,14 @@ float SFEWeatherMeterKit_getWindSpeed(SFEWeatherMeterKit *kit)
  */
 uint32_t SFEWeatherMeterKit_getWindSpeedCounts(SFEWeatherMeterKit *kit)
 {
-    return kit->windCounts;
+    updateWindSpeed(kit);
+    return (uint32_t)atomic_get(&kit->pulseHead) - kit->windowStartCount;
 }
 
 void SFEWeatherMeterKit_resetWindSpeedFilter(SFEWeatherMeterKit *kit)
 {
     kit->windCountsPrevious = 0;
-    kit->windCounts = 0;
+    kit->windowStartCount = (uint32_t)atomic_get(&kit->pulseHead);
     kit->lastWindSpeedMillis = k_uptime_get_32();
 }
 
@@ -301,30 +522,100 @@ float weather_station_get_wind_direction(WeatherStation *ws)
     return SFEWeatherMeterKit_getWindDirection(&ws->kit);
 }
 
+/* Boot number stamped on samples, see weather_station_set_boot() */
+static uint16_t boot_number;
+
+void weather_station_set_boot(uint16_t boot)
+{
+    boot_number = boot;
+}
+
+uint16_t weather_station_boot(void)
+{
+    return boot_number;
+}
+
+void weather_station_read(WeatherStation *ws, struct ws_sample *sample)
+{
+    sample->timestamp = k_uptime_get();
+    sample->boot = boot_number;
+    sample->station = ws->station_id;
+    sample->wind_speed = MIN(SFEWeatherMeterKit_getWindSpeedCentiKph(&ws->kit), UINT16_MAX);
+#if defined(CONFIG_WEATHER_STATION_VANE_OVERSAMPLING)
+    struct wind_vane_report report;
+    wind_vane_take_report(&ws->kit, &report);
+    sample->wind_direction = report.mean;
+#else
+    sample->wind_direction = SFEWeatherMeterKit_getWindDirectionDeciDegrees(&ws->kit);
+    if (sample->wind_direction < 0) {
+        sample->wind_direction = -1;
+    }
+#endif
+}
+
 /*----------------------------------------------------------------------------
  * GPIO Interrupt Callback for Wind Speed Sensor
  *----------------------------------------------------------------------------
+ * The kit is recovered from its embedded callback structure, so every kit has
+ * its own context. Only records the edge: its timestamps go into the ring slot
+ * for this count, then the count is published with an atomic increment (a full
+ * barrier), so a reader that sees the new count also sees the timestamp.
  */
 static void wind_speed_callback(const struct device *dev,
                                 struct gpio_callback *cb,
                                 uint32_t pins)
 {
-    if (kit_instance != NULL) {
-        updateWindSpeed(kit_instance);
-        kit_instance->windCounts++;
-    }
+    SFEWeatherMeterKit *kit = CONTAINER_OF(cb, SFEWeatherMeterKit, wind_speed_cb);
+    atomic_val_t n = atomic_get(&kit->pulseHead);
+
+    kit->pulseStamps[n & (SFE_WMK_PULSE_RING_SIZE - 1)] = k_uptime_get_32();
+    kit->pulseCycles[n & (SFE_WMK_PULSE_RING_SIZE - 1)] = k_cycle_get_32();
+    atomic_inc(&kit->pulseHead);
 }
 
 /*----------------------------------------------------------------------------
  * Helper Functions for Initializations
  *----------------------------------------------------------------------------
  */
-void weather_station_init(WeatherStation *ws,
-    const struct device *adc_dev,
-    const struct device *gpio_dev,
-    uint32_t gpio_pin)
+int weather_station_init(WeatherStation *ws, const struct weather_station_config *config)
 {
-    SFEWeatherMeterKit_init(&ws->kit, adc_dev, 0, gpio_dev, gpio_pin);
-    SFEWeatherMeterKit_setADCResolutionBits(&ws->kit, 10);
-    SFEWeatherMeterKit_begin(&ws->kit);
+    int ret;
+
+    if (!adc_is_ready_dt(&config->vane) || !gpio_is_ready_dt(&config->anemometer)) {
+        printk("Station %u: devices not ready\n", config->station_id);
+        return -ENODEV;
+    }
+
+    ws->station_id = config->station_id;
+    SFEWeatherMeterKit_init(&ws->kit, config->vane.dev, config->vane.channel_id,
+                            config->anemometer.port, config->anemometer.pin);
+    if (config->vane.channel_cfg_dt_node_exists) {
+        /* The channel's zephyr,gain, zephyr,reference and acquisition time replace the defaults */
+        ret = adc_channel_setup_dt(&config->vane);
+        if (ret < 0) {
+            printk("Station %u: vane channel setup failed (%d)\n", config->station_id, ret);
+            return ret;
+        }
+        ws->kit.wind_dir_adc_gain = config->vane.channel_cfg.gain;
+        SFEWeatherMeterKit_setADCResolutionBits(&ws->kit, config->vane.resolution);
+    }
+#if defined(CONFIG_WEATHER_STATION_SPEED_FILTER)
+    SFEWeatherMeterKitSpeedMode mode = IS_ENABLED(CONFIG_WEATHER_STATION_SPEED_PERIOD_AVG) ?
+                                       SFE_WMK_SPEED_PERIOD_AVG : SFE_WMK_SPEED_PERIOD_EMA;
+
+    ret = SFEWeatherMeterKit_setWindSpeedMode(&ws->kit, mode,
+                                              CONFIG_WEATHER_STATION_SPEED_FILTER);
+    if (ret < 0) {
+        printk("Station %u: speed filter %d out of range (%d), counting in windows\n",
+               config->station_id, CONFIG_WEATHER_STATION_SPEED_FILTER, ret);
+    }
+#endif
+    ret = SFEWeatherMeterKit_begin(&ws->kit);
+    if (ret < 0) {
+        return ret;
+    }
+#if defined(CONFIG_WEATHER_STATION_VANE_OVERSAMPLING)
+    ret = wind_vane_start(&ws->kit);
+#endif
+    return ret;
 }
@@ -5,36 +5,60 @@
  */
 
 #include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(wifi); 
+LOG_MODULE_REGISTER(wifi, CONFIG_WEATHER_STATION_LOG_LEVEL);
 #include <zephyr/net/wifi_mgmt.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/atomic.h>
+#include <errno.h>
 
-static int connected;
+#include "wifi.h"
+
+/* How long an accepted connect request may take to report a result */
+#define WIFI_ATTEMPT_TIMEOUT_MS 30000
+
+/* Posted to wifi_events while the network is connected */
+#define WIFI_EVT_CONNECTED BIT(0)
+
+/* Bits of flags, set by the API and the management callback for the state machine */
+enum {
+    WIFI_FLAG_REGISTERED, /* Management callback added */
+    WIFI_FLAG_WANTED,     /* The application wants the connection up */
+    WIFI_FLAG_UP,         /* Connect result: success */
+    WIFI_FLAG_FAILED,     /* Connect result: failure */
+    WIFI_FLAG_LOST,       /* Disconnect result */
+};
+
+enum wifi_state {
+    WIFI_STATE_DOWN,       /* Disconnected, no request in progress */
+    WIFI_STATE_CONNECTING, /* Connect request accepted, waiting for the result */
+    WIFI_STATE_CONNECTED,
+    WIFI_STATE_BACKOFF,    /* Waiting to retry after a failure */
+};
+
+static void wifi_work_fn(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(wifi_work, wifi_work_fn);
+static K_EVENT_DEFINE(wifi_events);
+static atomic_t flags;
 static struct net_mgmt_event_callback wifi_shell_mgmt_cb;
- 
-/**
- * @brief Handle the result of a WiFi connection attempt.
- *
- * Processes the connection status received from the WiFi management event callback.
- *
- * @param cb Pointer to the net management event callback containing WiFi status information.
- */
-static void handle_wifi_connect_result(struct net_mgmt_event_callback *cb)
-{
-    const struct wifi_status *status = (const struct wifi_status *)
-                    cb->info;
 
-    if (status->status) {
-        LOG_ERR("Connection request failed (%d)", status->status);
-    } else {
-        LOG_INF("WIFI Connected");
-        connected = 1;
-    }
-}
- 
+/* Owned by the work handler */
+static enum wifi_state state;
+static int64_t deadline;
+static uint32_t backoff_ms = CONFIG_HTTP_WIFI_RETRY_MIN_MS;
+static struct wifi_stats stats;
+
+/* A zero backoff would retry at once, and doubling it must not wrap */
+BUILD_ASSERT(CONFIG_HTTP_WIFI_RETRY_MIN_MS >= 1 &&
+             CONFIG_HTTP_WIFI_RETRY_MIN_MS <= CONFIG_HTTP_WIFI_RETRY_MAX_MS &&
+             CONFIG_HTTP_WIFI_RETRY_MAX_MS <= UINT32_MAX / 2,
+             "the WIFI reconnect backoff must be at least 1 ms and at most its maximum");
+
 /**
  * @brief WiFi management event handler.
  *
- * Handles WiFi management events.
+ * Records connect and disconnect results for the state machine and runs it. Runs in the
+ * network management thread, so it does no more than that.
  *
  * @param cb Pointer to the net management event callback.
  * @param mgmt_event The management event identifier.
@@ -43,62 +67,196 @@ static void handle_wifi_connect_result(struct net_mgmt_event_callback *cb)
 static void wifi_mgmt_event_handler(struct net_mgmt_event_callback *cb,
                     uint32_t mgmt_event, struct net_if *iface)
 {
+    const struct wifi_status *status = (const struct wifi_status *)cb->info;
+
     switch (mgmt_event) {
     case NET_EVENT_WIFI_CONNECT_RESULT:
-        handle_wifi_connect_result(cb);
+        if (status->status) {
+            LOG_ERR("Connection request failed (%d)", status->status);
+            atomic_set_bit(&flags, WIFI_FLAG_FAILED);
+        } else {
+            atomic_set_bit(&flags, WIFI_FLAG_UP);
+        }
         break;
-    default:
+    case NET_EVENT_WIFI_DISCONNECT_RESULT:
+        k_event_clear(&wifi_events, WIFI_EVT_CONNECTED);
+        atomic_set_bit(&flags, WIFI_FLAG_LOST);
         break;
+    default:
+        return;
     }
+    k_work_reschedule(&wifi_work, K_NO_WAIT);
 }
- 
+
 /**
- * @brief Initiate a WiFi connection.
+ * @brief Schedule the next connection attempt after a failure.
  *
- * Registers the WiFi management callback, configures connection parameters, 
- * and attempts to connect up to 10 times, waiting until a connection is established.
+ * The delay doubles after each consecutive failure up to CONFIG_HTTP_WIFI_RETRY_MAX_MS, and is
+ * drawn at random from its upper half so that stations rebooted together by a power cut do
+ * not retry in lockstep.
  */
-void wifi_connect(void)
+static void wifi_backoff(int64_t now)
 {
-    int nr_tries = 10;
-    int ret = 0;
-
-    net_mgmt_init_event_callback(&wifi_shell_mgmt_cb,
-                    wifi_mgmt_event_handler,
-                    NET_EVENT_WIFI_CONNECT_RESULT);
+    uint32_t delay = backoff_ms / 2 + sys_rand32_get() % (backoff_ms / 2 + 1);
 
-    net_mgmt_add_event_callback(&wifi_shell_mgmt_cb);
+    LOG_INF("WIFI retrying in %u ms", delay);
+    state = WIFI_STATE_BACKOFF;
+    deadline = now + delay;
+    stats.failures++;
+    stats.backoff_ms = backoff_ms;
+    backoff_ms = MIN(2 * backoff_ms, CONFIG_HTTP_WIFI_RETRY_MAX_MS);
+}
 
-    struct net_if *iface = net_if_get_default();
+/**
+ * @brief Send a connect request, using the SSID and PSK from the build configuration.
+ */
+static void wifi_attempt(int64_t now)
+{
     static struct wifi_connect_req_params cnx_params = {
         .ssid = CONFIG_HTTP_WIFI_SSID,
-        .ssid_length = 0,
+        .ssid_length = sizeof(CONFIG_HTTP_WIFI_SSID) - 1,
         .psk = CONFIG_HTTP_WIFI_PSK,
-        .psk_length = 0,
+        .psk_length = sizeof(CONFIG_HTTP_WIFI_PSK) - 1,
         .channel = 0,
         .security = WIFI_SECURITY_TYPE_PSK,
     };
+    int ret;
 
-    cnx_params.ssid_length = strlen(CONFIG_HTTP_WIFI_SSID);
-    cnx_params.psk_length = strlen(CONFIG_HTTP_WIFI_PSK);
+    LOG_INF("WIFI try connecting to %s...", CONFIG_HTTP_WIFI_SSID);
+    stats.attempts++;
 
-    connected = 0;
+    ret = net_mgmt(NET_REQUEST_WIFI_CONNECT, net_if_get_default(), &cnx_params,
+                   sizeof(struct wifi_connect_req_params));
+    if (ret < 0 && ret != -EALREADY) {
+        /* Typically the interface is not up yet, shortly after boot */
+        LOG_INF("Connect request failed %d", ret);
+        wifi_backoff(now);
+        return;
+    }
 
-    LOG_INF("WIFI try connecting to %s...", CONFIG_HTTP_WIFI_SSID);
+    state = WIFI_STATE_CONNECTING;
+    deadline = now + WIFI_ATTEMPT_TIMEOUT_MS;
+}
 
-    /* Let's wait few seconds to allow wifi device be on-line */
-    while (nr_tries-- > 0) {
-        ret = net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, &cnx_params,
-                sizeof(struct wifi_connect_req_params));
-        if (ret == 0) {
-            break;
+/**
+ * @brief Connection state machine, run on the system workqueue.
+ *
+ * Runs whenever the management callback reports a result, the application changes whether
+ * it wants the connection, or a backoff or attempt deadline passes.
+ */
+static void wifi_work_fn(struct k_work *work)
+{
+    bool wanted = atomic_test_bit(&flags, WIFI_FLAG_WANTED);
+    int64_t now = k_uptime_get();
+
+    if (atomic_test_and_clear_bit(&flags, WIFI_FLAG_LOST) && state == WIFI_STATE_CONNECTED) {
+        LOG_INF("WIFI Disconnected");
+        state = WIFI_STATE_DOWN;
+        if (wanted) {
+            stats.lost++;
         }
+    }
+    if (atomic_test_and_clear_bit(&flags, WIFI_FLAG_FAILED) &&
+        state == WIFI_STATE_CONNECTING) {
+        wifi_backoff(now);
+    }
+    if (atomic_test_and_clear_bit(&flags, WIFI_FLAG_UP)) {
+        LOG_INF("WIFI Connected");
+        state = WIFI_STATE_CONNECTED;
+        backoff_ms = CONFIG_HTTP_WIFI_RETRY_MIN_MS;
+        stats.connects++;
+        k_event_post(&wifi_events, WIFI_EVT_CONNECTED);
+    }
 
-        LOG_INF("Connect request failed %d. Waiting iface be up...", ret);
-        k_msleep(500);
+    switch (state) {
+    case WIFI_STATE_DOWN:
+        if (wanted) {
+            wifi_attempt(now);
+        }
+        break;
+    case WIFI_STATE_CONNECTING:
+        if (wanted && now >= deadline) {
+            LOG_ERR("WIFI connection attempt timed out");
+            wifi_backoff(now);
+        }
+        break;
+    case WIFI_STATE_BACKOFF:
+        if (wanted && now >= deadline) {
+            wifi_attempt(now);
+        }
+        break;
+    case WIFI_STATE_CONNECTED:
+        break;
     }
 
-    while (connected == 0) {
-        k_msleep(100);
+    if (!wanted && state != WIFI_STATE_DOWN) {
+        /* Also aborts an attempt in progress */
+        int ret = net_mgmt(NET_REQUEST_WIFI_DISCONNECT, net_if_get_default(), NULL, 0);
+        if (ret < 0 && ret != -EALREADY) {
+            LOG_ERR("Disconnect request failed (%d)", ret);
+        }
+        k_event_clear(&wifi_events, WIFI_EVT_CONNECTED);
+        state = WIFI_STATE_DOWN;
+        backoff_ms = CONFIG_HTTP_WIFI_RETRY_MIN_MS;
     }
-}
\ No newline at end of file
+
+    if (state == WIFI_STATE_CONNECTING || state == WIFI_STATE_BACKOFF) {
+        k_work_reschedule(&wifi_work, K_TIMEOUT_ABS_MS(deadline));
+    }
+}
+
+void wifi_start(void)
+{
+    if (!atomic_test_and_set_bit(&flags, WIFI_FLAG_REGISTERED)) {
+        net_mgmt_init_event_callback(&wifi_shell_mgmt_cb,
+                        wifi_mgmt_event_handler,
+                        NET_EVENT_WIFI_CONNECT_RESULT | NET_EVENT_WIFI_DISCONNECT_RESULT);
+
+        net_mgmt_add_event_callback(&wifi_shell_mgmt_cb);
+    }
+
+    if (!atomic_test_and_set_bit(&flags, WIFI_FLAG_WANTED)) {
+        k_work_reschedule(&wifi_work, K_NO_WAIT);
+    }
+}
+
+int wifi_up(k_timeout_t timeout)
+{
+    wifi_start();
+
+    if (k_event_wait(&wifi_events, WIFI_EVT_CONNECTED, false, timeout) == 0) {
+        LOG_ERR("WIFI connection timed out");
+        return -ETIMEDOUT;
+    }
+    return 0;
+}
+
+int wifi_down(void)
+{
+    if (atomic_test_and_clear_bit(&flags, WIFI_FLAG_WANTED)) {
+        k_event_clear(&wifi_events, WIFI_EVT_CONNECTED);
+        k_work_reschedule(&wifi_work, K_NO_WAIT);
+    }
+    return 0;
+}
+
+int wifi_power_save(bool enable)
+{
+    struct wifi_ps_params params = {
+        .type = WIFI_PS_PARAM_STATE,
+        .enabled = enable ? WIFI_PS_ENABLED : WIFI_PS_DISABLED,
+    };
+    int ret;
+
+    ret = net_mgmt(NET_REQUEST_WIFI_PS, net_if_get_default(), &params, sizeof(params));
+    if (ret < 0) {
+        LOG_ERR("Power save request failed (%d)", ret);
+    }
+    return ret;
+}
+
+void wifi_get_stats(struct wifi_stats *out)
+{
+    /* Updated by the workqueue; a report may mix two updates, which is fine for counters */
+    *out = stats;
+}
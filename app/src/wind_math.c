@@ -0,0 +1,125 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "wind_math.h"
+
+/* cos(0..90 degrees) in Q15 */
+static const int16_t cos_table[91] = {
+    32767, 32762, 32747, 32722, 32687, 32642, 32587, 32523, 32448, 32364,
+    32269, 32165, 32051, 31927, 31794, 31650, 31498, 31335, 31163, 30982,
+    30791, 30591, 30381, 30162, 29934, 29697, 29451, 29196, 28932, 28659,
+    28377, 28087, 27788, 27481, 27165, 26841, 26509, 26169, 25821, 25465,
+    25101, 24730, 24351, 23964, 23571, 23170, 22762, 22347, 21925, 21497,
+    21062, 20621, 20173, 19720, 19260, 18794, 18323, 17846, 17364, 16876,
+    16384, 15886, 15383, 14876, 14364, 13848, 13328, 12803, 12275, 11743,
+    11207, 10668, 10126,  9580,  9032,  8481,  7927,  7371,  6813,  6252,
+     5690,  5126,  4560,  3993,  3425,  2856,  2286,  1715,  1144,   572,
+        0,
+};
+
+/* Cosine of 0 to 90 degrees, in 0.1 degrees, interpolated */
+static int32_t cos_quarter(int32_t ddeg)
+{
+    int32_t deg = ddeg / 10;
+    int32_t frac = ddeg % 10;
+
+    if (frac == 0) {
+        return cos_table[deg];
+    }
+    return cos_table[deg] + (cos_table[deg + 1] - cos_table[deg]) * frac / 10;
+}
+
+int16_t wm_cos_q15(int32_t ddeg)
+{
+    ddeg %= 3600;
+    if (ddeg < 0) {
+        ddeg += 3600;
+    }
+
+    if (ddeg <= 900) {
+        return cos_quarter(ddeg);
+    } else if (ddeg <= 1800) {
+        return -cos_quarter(1800 - ddeg);
+    } else if (ddeg <= 2700) {
+        return -cos_quarter(ddeg - 1800);
+    }
+    return cos_quarter(3600 - ddeg);
+}
+
+int16_t wm_sin_q15(int32_t ddeg)
+{
+    return wm_cos_q15(ddeg - 900);
+}
+
+/*
+ * atan(z) for z = num / den in [0, 1], in 0.1 degrees, using
+ * atan(z) ~= pi/4 z + 0.273 z (1 - z) (error below 0.25 degrees).
+ */
+static int32_t atan_ratio_ddeg(uint64_t num, uint64_t den)
+{
+    /* Scale down so the Q15 ratio cannot overflow */
+    while (den > (UINT64_C(1) << 47)) {
+        num >>= 1;
+        den >>= 1;
+    }
+    int64_t z = (int64_t)((num << 15) / den);
+
+    return (int32_t)((450 * z + 156 * ((z * (32768 - z)) >> 15) + (1 << 14)) >> 15);
+}
+
+int32_t wm_atan2_ddeg(int64_t east, int64_t north)
+{
+    uint64_t ae = east < 0 ? -(uint64_t)east : (uint64_t)east;
+    uint64_t an = north < 0 ? -(uint64_t)north : (uint64_t)north;
+    int32_t angle;
+
+    if (ae == 0 && an == 0) {
+        return -1;
+    }
+
+    /* Angle from the north/south axis, 0 to 90 degrees */
+    if (ae <= an) {
+        angle = atan_ratio_ddeg(ae, an);
+    } else {
+        angle = 900 - atan_ratio_ddeg(an, ae);
+    }
+
+    if (north < 0) {
+        angle = 1800 - angle;
+    }
+    if (east < 0) {
+        angle = 3600 - angle;
+    }
+    return angle % 3600;
+}
+
+int32_t wm_angle_diff_ddeg(int32_t a, int32_t b)
+{
+    int32_t diff = (a - b) % 3600;
+
+    if (diff < 0) {
+        diff += 3600;
+    }
+    return diff > 1800 ? 3600 - diff : diff;
+}
+
+uint32_t wm_isqrt(uint64_t value)
+{
+    uint64_t result = 0;
+    uint64_t bit = UINT64_C(1) << 62;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)result;
+}
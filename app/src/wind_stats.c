@@ -0,0 +1,306 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+
+#include "wind_stats.h"
+#include "wind_math.h"
+
+/* Period lengths in samples */
+#define PERIOD_SAMPLES(ms) MAX(1, (ms) / CONFIG_WEATHER_STATION_SAMPLE_PERIOD_MS)
+#define GUST_N  PERIOD_SAMPLES(WIND_STATS_GUST_MS)
+#define SHORT_N PERIOD_SAMPLES(WIND_STATS_SHORT_MS)
+#define LONG_N  PERIOD_SAMPLES(WIND_STATS_LONG_MS)
+
+/* Sample sequence numbers are 16 bits, and speed sums must fit 32 bits */
+BUILD_ASSERT(LONG_N <= UINT16_MAX, "sampling period too short for the 10 minute statistics");
+
+/* 2 / sqrt(3) - 1, the Yamartino correction coefficient, in Q15 */
+#define YAMARTINO_K 5069
+
+/*----------------------------------------------------------------------------
+ * Monotonic queues
+ *----------------------------------------------------------------------------
+ * Sliding-window minimum/maximum in amortised O(1): the queue holds the
+ * samples that can still become the extreme, in order, so the front is always
+ * the extreme of the window. Each sample is pushed and popped at most once.
+ */
+struct mono_entry {
+    uint16_t seq;
+    uint16_t value;
+};
+
+struct mono_queue {
+    struct mono_entry *buf;
+    uint16_t size;
+    uint16_t head;
+    uint16_t count;
+    bool max;
+};
+
+static void mono_push(struct mono_queue *q, uint16_t seq, uint16_t value)
+{
+    /* Expire the front once it falls out of the window */
+    if (q->count > 0 && (uint16_t)(seq - q->buf[q->head].seq) >= q->size) {
+        q->head = (q->head + 1) % q->size;
+        q->count--;
+    }
+
+    /* Drop samples that can no longer be the extreme */
+    while (q->count > 0) {
+        uint16_t back = q->buf[(q->head + q->count - 1) % q->size].value;
+        if (q->max ? back > value : back < value) {
+            break;
+        }
+        q->count--;
+    }
+
+    q->buf[(q->head + q->count) % q->size] = (struct mono_entry){ seq, value };
+    q->count++;
+}
+
+static uint16_t mono_front(const struct mono_queue *q)
+{
+    return q->count > 0 ? q->buf[q->head].value : 0;
+}
+
+/*----------------------------------------------------------------------------
+ * Averaging periods
+ *----------------------------------------------------------------------------
+ * Sums are updated by adding the new sample and subtracting the one leaving
+ * the period. Sines and cosines of a departing sample are recomputed from the
+ * same table, so the sums never drift.
+ */
+struct window {
+    uint16_t len;
+    uint16_t valid;    /* Samples in the period with a known direction */
+    uint32_t sum;      /* Speed */
+    int32_t sum_sin;   /* Unit vectors, Q15 */
+    int32_t sum_cos;
+    int64_t sum_east;  /* Wind vectors, 0.01 kph * Q15 */
+    int64_t sum_north;
+    struct mono_queue min;
+    struct mono_queue max;
+    struct mono_queue gust;
+};
+
+/* Sample history, as long as the longest period */
+struct entry {
+    uint16_t speed;
+    int16_t direction;
+};
+
+/* Statistics of one station */
+struct station_stats {
+    struct entry ring[LONG_N];
+    uint16_t ring_head;
+    uint16_t ring_used;
+    uint16_t seq;
+    uint32_t gust_sum;
+    uint16_t gust;
+    int64_t timestamp;
+    struct window windows[2]; /* 2 and 10 minutes */
+    struct mono_entry short_bufs[3 * SHORT_N]; /* min, max and gust queues */
+    struct mono_entry long_bufs[3 * LONG_N];
+};
+
+static struct k_spinlock lock;
+static struct station_stats stations[WS_NUM_STATIONS];
+
+static void window_init(struct window *w, uint16_t len, struct mono_entry *bufs)
+{
+    w->len = len;
+    w->min = (struct mono_queue){ .buf = &bufs[0], .size = len, .max = false };
+    w->max = (struct mono_queue){ .buf = &bufs[len], .size = len, .max = true };
+    w->gust = (struct mono_queue){ .buf = &bufs[2 * len], .size = len, .max = true };
+}
+
+/**
+ * @brief History entry @p age samples before the newest one (1 = newest).
+ */
+static const struct entry *ring_back(const struct station_stats *st, uint16_t age)
+{
+    uint16_t head = st->ring_head;
+
+    return &st->ring[head >= age ? head - age : head + LONG_N - age];
+}
+
+static void window_add(struct station_stats *st, struct window *w, const struct entry *e,
+                       int32_t s, int32_t c)
+{
+    if (st->ring_used >= w->len) {
+        const struct entry *old = ring_back(st, w->len);
+
+        w->sum -= old->speed;
+        if (old->direction >= 0) {
+            int32_t os = wm_sin_q15(old->direction);
+            int32_t oc = wm_cos_q15(old->direction);
+            w->valid--;
+            w->sum_sin -= os;
+            w->sum_cos -= oc;
+            w->sum_east -= (int64_t)old->speed * os;
+            w->sum_north -= (int64_t)old->speed * oc;
+        }
+    }
+
+    w->sum += e->speed;
+    if (e->direction >= 0) {
+        w->valid++;
+        w->sum_sin += s;
+        w->sum_cos += c;
+        w->sum_east += (int64_t)e->speed * s;
+        w->sum_north += (int64_t)e->speed * c;
+    }
+
+    mono_push(&w->min, st->seq, e->speed);
+    mono_push(&w->max, st->seq, e->speed);
+    mono_push(&w->gust, st->seq, st->gust);
+}
+
+int wind_stats_add(size_t station, const struct ws_sample *sample)
+{
+    const struct entry e = {
+        .speed = sample->wind_speed,
+        .direction = sample->wind_direction < 0 ? -1 : sample->wind_direction,
+    };
+    int32_t s = 0;
+    int32_t c = 0;
+
+    if (station >= ARRAY_SIZE(stations)) {
+        return -EINVAL;
+    }
+    if (e.direction >= 0) {
+        s = wm_sin_q15(e.direction);
+        c = wm_cos_q15(e.direction);
+    }
+
+    struct station_stats *st = &stations[station];
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (st->windows[0].len == 0) {
+        window_init(&st->windows[0], SHORT_N, st->short_bufs);
+        window_init(&st->windows[1], LONG_N, st->long_bufs);
+    }
+
+    /* 3 second running mean */
+    if (st->ring_used >= GUST_N) {
+        st->gust_sum -= ring_back(st, GUST_N)->speed;
+    }
+    st->gust_sum += e.speed;
+    st->gust = st->gust_sum / MIN(st->ring_used + 1, GUST_N);
+
+    /* Departing samples are read before the new one overwrites the oldest */
+    for (size_t i = 0; i < ARRAY_SIZE(st->windows); i++) {
+        window_add(st, &st->windows[i], &e, s, c);
+    }
+
+    st->ring[st->ring_head] = e;
+    st->ring_head = (st->ring_head + 1) % LONG_N;
+    if (st->ring_used < LONG_N) {
+        st->ring_used++;
+    }
+    st->seq++;
+    st->timestamp = sample->timestamp;
+
+    k_spin_unlock(&lock, key);
+    return 0;
+}
+
+/**
+ * @brief Yamartino estimate of the direction standard deviation.
+ *
+ * sigma = asin(e) * (1 + (2 / sqrt(3) - 1) * e^3), with e = sqrt(1 - R^2) and R the mean
+ * resultant length of the unit direction vectors.
+ */
+static int16_t yamartino_ddeg(int32_t sum_sin, int32_t sum_cos, uint32_t n)
+{
+    const int64_t one2 = (int64_t)WM_Q15_ONE * WM_Q15_ONE;
+    int64_t r2 = ((int64_t)sum_sin * sum_sin + (int64_t)sum_cos * sum_cos) / ((int64_t)n * n);
+
+    r2 = MIN(r2, one2);
+    int64_t eps = wm_isqrt(one2 - r2);
+    int64_t asin_ddeg = wm_atan2_ddeg(eps, wm_isqrt(r2));
+    int64_t eps3 = eps * eps / WM_Q15_ONE * eps / WM_Q15_ONE;
+
+    return asin_ddeg + asin_ddeg * (YAMARTINO_K * eps3 / WM_Q15_ONE) / WM_Q15_ONE;
+}
+
+/* Sums and extremes of a period, copied out under the lock */
+struct window_snapshot {
+    uint16_t count;
+    uint16_t valid;
+    uint32_t sum;
+    int32_t sum_sin;
+    int32_t sum_cos;
+    int64_t sum_east;
+    int64_t sum_north;
+    uint16_t min;
+    uint16_t max;
+    uint16_t gust;
+};
+
+static void window_snapshot(const struct station_stats *st, const struct window *w,
+                            struct window_snapshot *snap)
+{
+    snap->count = MIN(st->ring_used, w->len);
+    snap->valid = w->valid;
+    snap->sum = w->sum;
+    snap->sum_sin = w->sum_sin;
+    snap->sum_cos = w->sum_cos;
+    snap->sum_east = w->sum_east;
+    snap->sum_north = w->sum_north;
+    snap->min = mono_front(&w->min);
+    snap->max = mono_front(&w->max);
+    snap->gust = mono_front(&w->gust);
+}
+
+static void window_report(const struct window_snapshot *w, struct wind_stats_window *out)
+{
+    out->samples = w->count;
+    out->mean = w->count > 0 ? w->sum / w->count : 0;
+    out->min = w->min;
+    out->max = w->max;
+    out->gust = w->gust;
+
+    if (w->valid == 0) {
+        out->vector_speed = 0;
+        out->vector_direction = -1;
+        out->direction = -1;
+        out->direction_sd = -1;
+        return;
+    }
+
+    int64_t east = w->sum_east / w->valid;
+    int64_t north = w->sum_north / w->valid;
+    out->vector_speed = wm_isqrt((uint64_t)(east * east) + (uint64_t)(north * north)) /
+                        WM_Q15_ONE;
+    out->vector_direction = wm_atan2_ddeg(w->sum_east, w->sum_north);
+    out->direction = wm_atan2_ddeg(w->sum_sin, w->sum_cos);
+    out->direction_sd = yamartino_ddeg(w->sum_sin, w->sum_cos, w->valid);
+}
+
+int wind_stats_get(size_t station, struct wind_stats_report *out)
+{
+    struct window_snapshot snap[2];
+
+    if (station >= ARRAY_SIZE(stations)) {
+        return -EINVAL;
+    }
+
+    /* The arithmetic is done outside the lock */
+    const struct station_stats *st = &stations[station];
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    for (size_t i = 0; i < ARRAY_SIZE(snap); i++) {
+        window_snapshot(st, &st->windows[i], &snap[i]);
+    }
+    out->timestamp = st->timestamp;
+    out->gust = st->gust;
+    k_spin_unlock(&lock, key);
+
+    window_report(&snap[0], &out->short_term);
+    window_report(&snap[1], &out->long_term);
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/sys/printk.h>
+#include <string.h>
+#include <errno.h>
+
+#include "wind_vane.h"
+#include "wind_math.h"
+
+/*
+ * Below the sampler and the uplink (pipeline.c): a late block only shifts when its samples
+ * are taken, and every sample still lands in the reporting period's histogram
+ */
+#define VANE_PRIORITY    8
+#define VANE_STACK_SIZE  1024
+#define VANE_INTERVAL_US (USEC_PER_SEC / CONFIG_WEATHER_STATION_VANE_RATE_HZ)
+
+K_THREAD_STACK_DEFINE(vane_stack, VANE_STACK_SIZE);
+static struct k_thread vane_thread;
+static K_TIMER_DEFINE(pace_timer, NULL, NULL);
+
+/* Samples of the block being acquired */
+static int16_t block[CONFIG_WEATHER_STATION_VANE_BLOCK];
+
+/* Histogram of a station's current reporting period, shared with the sampling thread */
+struct vane_channel {
+    SFEWeatherMeterKit *kit;
+    uint32_t counts[WMK_NUM_ANGLES];
+    uint32_t invalid;
+};
+
+static struct k_spinlock lock;
+static struct vane_channel channels[WS_NUM_STATIONS];
+static atomic_t num_channels;
+
+static struct wind_vane_stats stats;
+
+/**
+ * @brief Read one block with a single repeated-sampling ADC sequence.
+ */
+static int read_block_sequence(SFEWeatherMeterKit *kit)
+{
+    const struct adc_sequence_options options = {
+        .interval_us     = VANE_INTERVAL_US,
+        .extra_samplings = ARRAY_SIZE(block) - 1,
+    };
+    const struct adc_sequence sequence = {
+        .options     = &options,
+        .channels    = BIT(kit->wind_dir_adc_channel),
+        .buffer      = block,
+        .buffer_size = sizeof(block),
+        .resolution  = kit->adcResolutionBits,
+    };
+
+    return adc_read(kit->adc_dev, &sequence);
+}
+
+/**
+ * @brief Read one block with timer-paced single conversions.
+ */
+static int read_block_paced(SFEWeatherMeterKit *kit)
+{
+    struct adc_sequence sequence = {
+        .channels    = BIT(kit->wind_dir_adc_channel),
+        .buffer_size = sizeof(block[0]),
+        .resolution  = kit->adcResolutionBits,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(block); i++) {
+        k_timer_status_sync(&pace_timer);
+        sequence.buffer = &block[i];
+        uint32_t start = k_cycle_get_32();
+        int ret = adc_read(kit->adc_dev, &sequence);
+        latency_hist_record_cycles(&weather_station_adc_hist, start);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Decode a block into the reporting period's histogram.
+ */
+static void decode_block(struct vane_channel *ch)
+{
+    SFEWeatherMeterKit *kit = ch->kit;
+    uint16_t block_counts[WMK_NUM_ANGLES] = { 0 };
+    uint16_t block_invalid = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(block); i++) {
+        int index = SFEWeatherMeterKit_decodeVaneIndex(kit, block[i]);
+        if (index < 0) {
+            block_invalid++;
+        } else {
+            block_counts[index]++;
+        }
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    for (int i = 0; i < WMK_NUM_ANGLES; i++) {
+        ch->counts[i] += block_counts[i];
+    }
+    ch->invalid += block_invalid;
+    k_spin_unlock(&lock, key);
+
+    stats.samples += ARRAY_SIZE(block);
+    stats.invalid += block_invalid;
+}
+
+static void vane_fn(void *p1, void *p2, void *p3)
+{
+    size_t next = 0;
+
+    while (1) {
+        /* One block from each station in turn */
+        struct vane_channel *ch = &channels[next];
+        SFEWeatherMeterKit *kit = ch->kit;
+        int ret;
+
+        next = (next + 1) % atomic_get(&num_channels);
+
+        if (!stats.paced) {
+            ret = read_block_sequence(kit);
+            if (ret == -ENOTSUP || ret == -EINVAL) {
+                printk("ADC sequences not supported, pacing single reads\n");
+                stats.paced = true;
+                k_timer_start(&pace_timer, K_USEC(VANE_INTERVAL_US), K_USEC(VANE_INTERVAL_US));
+                continue;
+            }
+        } else {
+            ret = read_block_paced(kit);
+        }
+
+        if (ret < 0) {
+            stats.errors++;
+            k_sleep(K_USEC(VANE_INTERVAL_US));
+            continue;
+        }
+        decode_block(ch);
+    }
+}
+
+int wind_vane_start(SFEWeatherMeterKit *kit)
+{
+    atomic_val_t n = atomic_get(&num_channels);
+
+    if (n >= ARRAY_SIZE(channels)) {
+        return -ENOMEM;
+    }
+
+    /* Publish the channel before the thread can see it */
+    channels[n].kit = kit;
+    atomic_inc(&num_channels);
+
+    if (n == 0) {
+        k_thread_create(&vane_thread, vane_stack, K_THREAD_STACK_SIZEOF(vane_stack),
+                        vane_fn, NULL, NULL, NULL, VANE_PRIORITY, 0, K_NO_WAIT);
+        k_thread_name_set(&vane_thread, "vane");
+    }
+    return 0;
+}
+
+void wind_vane_take_report(const SFEWeatherMeterKit *kit, struct wind_vane_report *out)
+{
+    uint32_t period_counts[WMK_NUM_ANGLES] = { 0 };
+    uint32_t period_invalid = 0;
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    for (atomic_val_t i = 0; i < atomic_get(&num_channels); i++) {
+        struct vane_channel *ch = &channels[i];
+        if (ch->kit == kit) {
+            memcpy(period_counts, ch->counts, sizeof(period_counts));
+            memset(ch->counts, 0, sizeof(ch->counts));
+            period_invalid = ch->invalid;
+            ch->invalid = 0;
+            break;
+        }
+    }
+    k_spin_unlock(&lock, key);
+
+    /* Sum of unit vectors, one per sample */
+    int64_t east = 0;
+    int64_t north = 0;
+    uint32_t n = 0;
+    for (int i = 0; i < WMK_NUM_ANGLES; i++) {
+        int32_t bearing = i * SFE_WIND_VANE_DECIDEGREES_PER_INDEX;
+        east += (int64_t)period_counts[i] * wm_sin_q15(bearing);
+        north += (int64_t)period_counts[i] * wm_cos_q15(bearing);
+        n += period_counts[i];
+    }
+
+    out->samples = MIN(n, UINT16_MAX);
+    out->invalid = MIN(period_invalid, UINT16_MAX);
+    if (n == 0) {
+        out->mean = -1;
+        out->variance = 0;
+    } else {
+        /* Mean resultant length R = |sum| / n, variance = 1 - R */
+        uint32_t length = wm_isqrt((uint64_t)(east * east) + (uint64_t)(north * north));
+        uint32_t r_pm = (uint32_t)(((uint64_t)length * 1000) / ((uint64_t)n * WM_Q15_ONE));
+        out->mean = wm_atan2_ddeg(east, north);
+        out->variance = 1000 - MIN(r_pm, 1000);
+    }
+}
+
+void wind_vane_get_stats(struct wind_vane_stats *out)
+{
+    *out = stats;
+}
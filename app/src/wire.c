@@ -0,0 +1,261 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "wire.h"
+
+/**
+ * @brief Append an unsigned LEB128 varint.
+ *
+ * @return size_t Number of bytes written, or 0 if it did not fit.
+ */
+static size_t put_varint(uint8_t *buf, size_t size, uint32_t value)
+{
+    size_t len = 0;
+
+    do {
+        if (len == size) {
+            return 0;
+        }
+        buf[len] = value & 0x7f;
+        value >>= 7;
+        if (value != 0) {
+            buf[len] |= 0x80;
+        }
+        len++;
+    } while (value != 0);
+
+    return len;
+}
+
+/**
+ * @brief Zigzag-encode a signed value: 0, -1, 1, -2, ... encode as 0, 1, 2, 3, ...
+ */
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * @brief Check that the samples can be framed: from one boot, so the header's boot number
+ * holds for all, and oldest first, so no interval is negative.
+ */
+static bool frameable(const struct ws_sample *samples, size_t count)
+{
+    for (size_t i = 1; i < count; i++) {
+        int64_t dt = samples[i].timestamp - samples[i - 1].timestamp;
+
+        if (samples[i].boot != samples[0].boot || dt < 0 || dt > INT32_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int wire_encode(uint8_t *buf, size_t size, const struct ws_sample *samples, size_t count)
+{
+    size_t len = WIRE_HEADER_SIZE;
+
+    if (count == 0 || count > WIRE_MAX_RECORDS || size < WIRE_HEADER_SIZE + WIRE_CRC_SIZE) {
+        return -ENOMEM;
+    }
+    if (!frameable(samples, count)) {
+        return -EINVAL;
+    }
+
+    buf[0] = WIRE_MAGIC;
+    buf[1] = WIRE_VERSION;
+    sys_put_le16(samples[0].station, &buf[2]);
+    sys_put_le16(samples[0].boot, &buf[4]);
+    sys_put_le32((uint32_t)samples[0].timestamp, &buf[6]);
+    buf[10] = count;
+
+    int64_t prev = samples[0].timestamp;
+    uint16_t prev_station = samples[0].station;
+    for (size_t i = 0; i < count; i++) {
+        const struct ws_sample *s = &samples[i];
+        int32_t dsta = (int32_t)s->station - prev_station;
+        int64_t dt = s->timestamp - prev;
+        size_t n;
+
+        n = put_varint(&buf[len], size - len - WIRE_CRC_SIZE, zigzag(dsta));
+        if (n == 0) {
+            return -ENOMEM;
+        }
+        len += n;
+
+        n = put_varint(&buf[len], size - len - WIRE_CRC_SIZE, (uint32_t)dt);
+        if (n == 0 || size - len - n < 4 + WIRE_CRC_SIZE) {
+            return -ENOMEM;
+        }
+        len += n;
+
+        sys_put_le16(s->wind_speed, &buf[len]);
+        sys_put_le16(s->wind_direction < 0 ? WIRE_DIR_INVALID : s->wind_direction,
+                     &buf[len + 2]);
+        len += 4;
+        prev = s->timestamp;
+        prev_station = s->station;
+    }
+
+    sys_put_le16(crc16_ccitt(0xffff, buf, len), &buf[len]);
+    return len + WIRE_CRC_SIZE;
+}
+
+/* State of a station in the packed frame being encoded, see wire.h */
+struct packed_station {
+    uint16_t station;
+    int16_t direction; /* 0.1 degrees, -1 if unknown */
+    uint16_t speed;
+    int32_t dt;
+    int64_t time;
+};
+
+/**
+ * @brief Find the state of a station, or start it the first time the station appears.
+ *
+ * @param stations State of the stations seen so far.
+ * @param seen     Number of stations that have appeared, including any whose slot was taken.
+ * @param station  Station id.
+ * @param time     Time of the previous sample, for a new station.
+ */
+static struct packed_station *packed_station_get(struct packed_station *stations, size_t *seen,
+                                                 uint16_t station, int64_t time)
+{
+    struct packed_station *st;
+
+    for (size_t i = 0; i < MIN(*seen, WIRE_PACKED_STATIONS); i++) {
+        if (stations[i].station == station) {
+            return &stations[i];
+        }
+    }
+
+    st = &stations[*seen % WIRE_PACKED_STATIONS];
+    (*seen)++;
+    *st = (struct packed_station){ .station = station, .direction = -1, .time = time };
+    return st;
+}
+
+/**
+ * @brief Change of direction the shorter way round the circle.
+ *
+ * @return The change in 0.1 degrees, -1799 to 1800.
+ */
+static int32_t direction_change(int32_t from, int32_t to)
+{
+    int32_t change = (to - from) % 3600;
+
+    if (change > 1800) {
+        change -= 3600;
+    } else if (change <= -1800) {
+        change += 3600;
+    }
+    return change;
+}
+
+int wire_encode_packed(uint8_t *buf, size_t size, const struct ws_sample *samples,
+                       size_t count)
+{
+    struct packed_station stations[WIRE_PACKED_STATIONS];
+    size_t seen = 0;
+    size_t len = WIRE_HEADER_SIZE;
+
+    if (count == 0 || count > WIRE_MAX_RECORDS || size < WIRE_HEADER_SIZE + WIRE_CRC_SIZE) {
+        return -ENOMEM;
+    }
+    if (!frameable(samples, count)) {
+        return -EINVAL;
+    }
+
+    buf[0] = WIRE_MAGIC;
+    buf[1] = WIRE_VERSION_PACKED;
+    sys_put_le16(samples[0].station, &buf[2]);
+    sys_put_le16(samples[0].boot, &buf[4]);
+    sys_put_le32((uint32_t)samples[0].timestamp, &buf[6]);
+    buf[10] = count;
+
+    int64_t prev_time = samples[0].timestamp;
+    uint16_t prev_station = samples[0].station;
+    for (size_t i = 0; i < count;) {
+        const struct ws_sample *s = &samples[i];
+        struct packed_station *st = packed_station_get(stations, &seen, s->station, prev_time);
+        int32_t dt = (int32_t)(s->timestamp - st->time);
+        int16_t direction = s->wind_direction < 0 ? -1 : s->wind_direction;
+        uint8_t record[WIRE_PACKED_RECORD_MAX];
+        uint8_t tag = 0;
+        uint8_t dir_mode = WIRE_PACKED_DIR_SAME;
+        size_t n = 1;
+
+        if (s->station != prev_station) {
+            tag |= WIRE_PACKED_STATION;
+            n += put_varint(&record[n], sizeof(record) - n,
+                            zigzag((int32_t)s->station - prev_station));
+        }
+        if (dt != st->dt) {
+            tag |= WIRE_PACKED_DT;
+            n += put_varint(&record[n], sizeof(record) - n, zigzag(dt - st->dt));
+        }
+        if (s->wind_speed != st->speed) {
+            tag |= WIRE_PACKED_SPEED;
+            n += put_varint(&record[n], sizeof(record) - n,
+                            zigzag((int32_t)s->wind_speed - st->speed));
+        }
+        if (direction < 0) {
+            dir_mode = st->direction < 0 ? WIRE_PACKED_DIR_SAME : WIRE_PACKED_DIR_UNKNOWN;
+        } else {
+            int32_t change = direction_change(MAX(st->direction, 0), direction);
+
+            if (st->direction >= 0 && change == 0) {
+                dir_mode = WIRE_PACKED_DIR_SAME;
+            } else if (change % WIRE_PACKED_SECTOR == 0) {
+                /* The vane's own positions are whole sectors apart */
+                dir_mode = WIRE_PACKED_DIR_SECTORS;
+                n += put_varint(&record[n], sizeof(record) - n,
+                                zigzag(change / WIRE_PACKED_SECTOR));
+            } else {
+                dir_mode = WIRE_PACKED_DIR_DELTA;
+                n += put_varint(&record[n], sizeof(record) - n, zigzag(change));
+            }
+        }
+        tag |= dir_mode << WIRE_PACKED_DIR_SHIFT;
+
+        st->time = s->timestamp;
+        st->dt = dt;
+        st->speed = s->wind_speed;
+        st->direction = direction;
+
+        /* Following samples that change nothing but the time, by the same interval */
+        size_t repeat = 0;
+        while (repeat < WIRE_PACKED_REPEAT_MAX && i + 1 + repeat < count) {
+            const struct ws_sample *next = &samples[i + 1 + repeat];
+
+            if (next->station != st->station || next->timestamp != st->time + st->dt ||
+                next->wind_speed != st->speed ||
+                (next->wind_direction < 0 ? -1 : next->wind_direction) != st->direction) {
+                break;
+            }
+            st->time = next->timestamp;
+            repeat++;
+        }
+        record[0] = tag | (repeat << WIRE_PACKED_REPEAT_SHIFT);
+
+        if (size - WIRE_CRC_SIZE - len < n) {
+            return -ENOMEM;
+        }
+        memcpy(&buf[len], record, n);
+        len += n;
+
+        i += 1 + repeat;
+        prev_time = st->time;
+        prev_station = s->station;
+    }
+
+    sys_put_le16(crc16_ccitt(0xffff, buf, len), &buf[len]);
+    return len + WIRE_CRC_SIZE;
+}
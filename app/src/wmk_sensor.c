@@ -0,0 +1,237 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define DT_DRV_COMPAT sparkfun_weather_meter_kit
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/logging/log.h>
+#include <errno.h>
+
+#if defined(CONFIG_SENSOR_ASYNC_API)
+#include <zephyr/rtio/rtio.h>
+#endif
+
+LOG_MODULE_REGISTER(wmk_sensor, CONFIG_SENSOR_LOG_LEVEL);
+
+#include "wmk_sensor.h"
+
+struct wmk_sensor_data {
+    WeatherStation ws;
+    struct k_mutex lock;   /* The kit is read by one thread at a time */
+    struct ws_sample last; /* Reading taken by the last sample fetch */
+};
+
+int wmk_sensor_read(const struct device *dev, struct ws_sample *sample)
+{
+    struct wmk_sensor_data *data = dev->data;
+
+    k_mutex_lock(&data->lock, K_FOREVER);
+    weather_station_read(&data->ws, sample);
+    k_mutex_unlock(&data->lock);
+    return 0;
+}
+
+WeatherStation *wmk_sensor_station(const struct device *dev)
+{
+    struct wmk_sensor_data *data = dev->data;
+
+    return &data->ws;
+}
+
+static bool wmk_channel_supported(int chan)
+{
+    return chan == SENSOR_CHAN_WMK_WIND_SPEED || chan == SENSOR_CHAN_WMK_WIND_DIRECTION;
+}
+
+static int wmk_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+    struct wmk_sensor_data *data = dev->data;
+
+    if (chan != SENSOR_CHAN_ALL && !wmk_channel_supported(chan)) {
+        return -ENOTSUP;
+    }
+    return wmk_sensor_read(dev, &data->last);
+}
+
+static int wmk_channel_get(const struct device *dev, enum sensor_channel chan,
+                           struct sensor_value *val)
+{
+    const struct wmk_sensor_data *data = dev->data;
+
+    switch ((int)chan) {
+    case SENSOR_CHAN_WMK_WIND_SPEED:
+        /* 0.01 kph */
+        val->val1 = data->last.wind_speed / 100;
+        val->val2 = (data->last.wind_speed % 100) * 10000;
+        return 0;
+    case SENSOR_CHAN_WMK_WIND_DIRECTION:
+        /* 0.1 degrees */
+        if (data->last.wind_direction < 0) {
+            return -ENODATA;
+        }
+        val->val1 = data->last.wind_direction / 10;
+        val->val2 = (data->last.wind_direction % 10) * 100000;
+        return 0;
+    default:
+        return -ENOTSUP;
+    }
+}
+
+#if defined(CONFIG_SENSOR_ASYNC_API)
+/*----------------------------------------------------------------------------
+ * Asynchronous read and decode
+ *----------------------------------------------------------------------------
+ * A read encodes the fixed-point sample as is into the RTIO buffer; readers
+ * decode it in place to Q31 with the decoder below.
+ */
+
+/* Fixed-point shifts of the decoded values: speeds below 1024 kph, bearings below 512 degrees */
+#define WMK_SPEED_SHIFT     10
+#define WMK_DIRECTION_SHIFT 9
+
+struct wmk_encoded_data {
+    uint64_t timestamp_ns;
+    uint16_t wind_speed;      /* 0.01 kph */
+    int16_t  wind_direction;  /* 0.1 degrees, negative if unknown */
+};
+
+static void wmk_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
+{
+    const struct sensor_read_config *cfg = iodev_sqe->sqe.iodev->data;
+    struct wmk_encoded_data *edata;
+    struct ws_sample sample;
+    uint8_t *buf;
+    uint32_t buf_len;
+    int rc;
+
+    if (cfg->is_streaming) {
+        rtio_iodev_sqe_err(iodev_sqe, -ENOTSUP);
+        return;
+    }
+
+    rc = rtio_sqe_rx_buf(iodev_sqe, sizeof(*edata), sizeof(*edata), &buf, &buf_len);
+    if (rc != 0) {
+        LOG_ERR("%s: no buffer for %u bytes", dev->name, (unsigned int)sizeof(*edata));
+        rtio_iodev_sqe_err(iodev_sqe, rc);
+        return;
+    }
+
+    /* Both channels come from the same reading, whichever were requested */
+    wmk_sensor_read(dev, &sample);
+    edata = (struct wmk_encoded_data *)buf;
+    edata->timestamp_ns = (uint64_t)sample.timestamp * NSEC_PER_MSEC;
+    edata->wind_speed = sample.wind_speed;
+    edata->wind_direction = sample.wind_direction;
+
+    rtio_iodev_sqe_ok(iodev_sqe, 0);
+}
+
+static int wmk_decoder_get_frame_count(const uint8_t *buffer, struct sensor_chan_spec chan_spec,
+                                       uint16_t *frame_count)
+{
+    const struct wmk_encoded_data *edata = (const struct wmk_encoded_data *)buffer;
+
+    if (chan_spec.chan_idx != 0 || !wmk_channel_supported(chan_spec.chan_type)) {
+        return -ENOTSUP;
+    }
+    if (chan_spec.chan_type == SENSOR_CHAN_WMK_WIND_DIRECTION && edata->wind_direction < 0) {
+        return -ENODATA;
+    }
+
+    *frame_count = 1;
+    return 0;
+}
+
+static int wmk_decoder_get_size_info(struct sensor_chan_spec chan_spec, size_t *base_size,
+                                     size_t *frame_size)
+{
+    if (!wmk_channel_supported(chan_spec.chan_type)) {
+        return -ENOTSUP;
+    }
+
+    *base_size = sizeof(struct sensor_q31_data);
+    *frame_size = sizeof(struct sensor_q31_sample_data);
+    return 0;
+}
+
+static int wmk_decoder_decode(const uint8_t *buffer, struct sensor_chan_spec chan_spec,
+                              uint32_t *fit, uint16_t max_count, void *data_out)
+{
+    const struct wmk_encoded_data *edata = (const struct wmk_encoded_data *)buffer;
+    struct sensor_q31_data *out = data_out;
+    uint16_t frames;
+    int rc;
+
+    rc = wmk_decoder_get_frame_count(buffer, chan_spec, &frames);
+    if (rc < 0) {
+        return rc;
+    }
+    if (*fit != 0 || max_count == 0) {
+        return 0;
+    }
+
+    out->header.base_timestamp_ns = edata->timestamp_ns;
+    out->header.reading_count = 1;
+    out->readings[0].timestamp_delta = 0;
+
+    /* value = reading * 2^(31 - shift) / scale */
+    if (chan_spec.chan_type == SENSOR_CHAN_WMK_WIND_SPEED) {
+        out->shift = WMK_SPEED_SHIFT;
+        out->readings[0].value =
+            (q31_t)(((int64_t)edata->wind_speed << (31 - WMK_SPEED_SHIFT)) / 100);
+    } else {
+        out->shift = WMK_DIRECTION_SHIFT;
+        out->readings[0].value =
+            (q31_t)(((int64_t)edata->wind_direction << (31 - WMK_DIRECTION_SHIFT)) / 10);
+    }
+
+    *fit = 1;
+    return 1;
+}
+
+SENSOR_DECODER_API_DT_DEFINE() = {
+    .get_frame_count = wmk_decoder_get_frame_count,
+    .get_size_info = wmk_decoder_get_size_info,
+    .decode = wmk_decoder_decode,
+};
+
+static int wmk_get_decoder(const struct device *dev, const struct sensor_decoder_api **decoder)
+{
+    ARG_UNUSED(dev);
+    *decoder = &SENSOR_DECODER_NAME();
+    return 0;
+}
+#endif /* CONFIG_SENSOR_ASYNC_API */
+
+static DEVICE_API(sensor, wmk_api) = {
+    .sample_fetch = wmk_sample_fetch,
+    .channel_get = wmk_channel_get,
+#if defined(CONFIG_SENSOR_ASYNC_API)
+    .submit = wmk_submit,
+    .get_decoder = wmk_get_decoder,
+#endif
+};
+
+static int wmk_init(const struct device *dev)
+{
+    struct wmk_sensor_data *data = dev->data;
+    const struct weather_station_config *config = dev->config;
+
+    k_mutex_init(&data->lock);
+    data->last.wind_direction = -1;
+
+    return weather_station_init(&data->ws, config);
+}
+
+#define WMK_DEFINE(inst)                                                                \
+    static struct wmk_sensor_data wmk_data_##inst;                                      \
+    static const struct weather_station_config wmk_config_##inst =                      \
+        WEATHER_STATION_CONFIG_DT(DT_DRV_INST(inst));                                   \
+    SENSOR_DEVICE_DT_INST_DEFINE(inst, wmk_init, NULL, &wmk_data_##inst,                \
+                                 &wmk_config_##inst, POST_KERNEL,                       \
+                                 CONFIG_SENSOR_INIT_PRIORITY, &wmk_api);
+
+DT_INST_FOREACH_STATUS_OKAY(WMK_DEFINE)
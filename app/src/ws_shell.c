@@ -0,0 +1,289 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+#include <errno.h>
+#include <string.h>
+
+#include "dns_cache.h"
+#include "journal.h"
+#include "latency_hist.h"
+#include "pipeline.h"
+#include "reporting.h"
+#include "uplink.h"
+#include "wifi.h"
+#include "wmk_sensor.h"
+
+/* Weather meter kit sensor devices declared in the devicetree */
+#define STATION_DEVICE(node_id) DEVICE_DT_GET(node_id),
+static const struct device *const station_devs[] = {
+    DT_FOREACH_STATUS_OKAY(sparkfun_weather_meter_kit, STATION_DEVICE)
+};
+
+/* Anemometer edge counts at the previous "ws stats sensor", for the pulse rates */
+static uint32_t prev_pulses[WS_NUM_STATIONS];
+static int64_t prev_pulses_ms;
+
+/* Percentiles shown for each latency histogram */
+static const uint8_t percentiles[] = { 50, 90, 99 };
+
+static void print_hist(const struct shell *sh, const char *name,
+                       const struct latency_hist *hist)
+{
+    uint32_t count = latency_hist_count(hist);
+    char bounds[ARRAY_SIZE(percentiles)][16];
+
+    if (count == 0) {
+        shell_print(sh, "%s: none", name);
+        return;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(percentiles); i++) {
+        uint32_t bound = latency_hist_percentile(hist, percentiles[i]);
+        if (bound == UINT32_MAX) {
+            snprintk(bounds[i], sizeof(bounds[i]), ">=%u", LATENCY_HIST_OVERFLOW_US);
+        } else {
+            snprintk(bounds[i], sizeof(bounds[i]), "<%u", bound);
+        }
+    }
+    shell_print(sh, "%s: %u, p50 %s, p90 %s, p99 %s us", name, count, bounds[0], bounds[1],
+                bounds[2]);
+}
+
+static int cmd_stats_sensor(const struct shell *sh, size_t argc, char **argv)
+{
+    int64_t now = k_uptime_get();
+    uint32_t elapsed_ms = MAX(1, (uint32_t)(now - prev_pulses_ms));
+
+    for (size_t i = 0; i < ARRAY_SIZE(station_devs); i++) {
+        if (!device_is_ready(station_devs[i])) {
+            shell_print(sh, "%s: not ready", station_devs[i]->name);
+            continue;
+        }
+
+        WeatherStation *ws = wmk_sensor_station(station_devs[i]);
+        uint32_t pulses = (uint32_t)atomic_get(&ws->kit.pulseHead);
+        uint32_t rate_x10 = (uint32_t)((uint64_t)(pulses - prev_pulses[i]) * 10000 /
+                                       elapsed_ms);
+
+        shell_print(sh, "%s (station %u): %u pulses, %u.%u pulses/s over %u ms",
+                    station_devs[i]->name, ws->station_id, pulses, rate_x10 / 10,
+                    rate_x10 % 10, elapsed_ms);
+        prev_pulses[i] = pulses;
+    }
+    prev_pulses_ms = now;
+
+    print_hist(sh, "ADC read", &weather_station_adc_hist);
+    return 0;
+}
+
+static int cmd_stats_queue(const struct shell *sh, size_t argc, char **argv)
+{
+    struct pipeline_stats pipe;
+
+    pipeline_get_stats(&pipe);
+    shell_print(sh, "Samples: %u taken, %u sent, %u dropped", pipe.produced, pipe.consumed,
+                pipe.dropped);
+    shell_print(sh, "Queue: depth %u of %u, max %u", pipe.depth,
+                CONFIG_WEATHER_STATION_QUEUE_DEPTH, pipe.high_water);
+    shell_print(sh, "Sampler: late %u us max, %u wake-ups; uplink %u wake-ups",
+                pipe.max_late_us, pipe.sampler_wakeups, pipe.uplink_wakeups);
+    print_hist(sh, "Sample log", &pipeline_trace_hist);
+    if (pipe.delivered > 0) {
+        shell_print(sh, "Sample to send: last %u, max %u, avg %u ms", pipe.delivery_last_ms,
+                    pipe.delivery_max_ms, (uint32_t)(pipe.delivery_total_ms / pipe.delivered));
+    }
+#if defined(CONFIG_WEATHER_STATION_JOURNAL)
+    struct journal_stats journal;
+    journal_get_stats(&journal);
+    shell_print(sh, "Journal: %u pending, %u stored, %u replayed, %u dropped", journal.pending,
+                journal.appended, journal.replayed, journal.dropped);
+#endif
+    return 0;
+}
+
+static int cmd_stats_uplink(const struct shell *sh, size_t argc, char **argv)
+{
+    struct uplink_stats stats;
+    struct dns_cache_stats dns;
+    struct wifi_stats wifi;
+
+    uplink_get_stats(&stats);
+    shell_print(sh, "Uplink: %u ok (%u samples), %u failed, %u connects, %u reconnects",
+                stats.requests, stats.samples, stats.failures, stats.connects,
+                stats.reconnects);
+    print_hist(sh, "DNS lookup", &dns_cache_lookup_hist);
+    print_hist(sh, "Connect", &uplink_connect_hist);
+    print_hist(sh, "Request", &uplink_request_hist);
+
+    dns_cache_get_stats(&dns);
+    shell_print(sh, "DNS cache: %u hits, %u misses, %u stale, %u failures", dns.hits,
+                dns.misses, dns.stale, dns.failures);
+
+    wifi_get_stats(&wifi);
+    shell_print(sh, "WiFi: %u connects, %u failures, %u lost", wifi.connects, wifi.failures,
+                wifi.lost);
+    return 0;
+}
+
+#if defined(CONFIG_THREAD_RUNTIME_STATS)
+static k_thread_runtime_stats_t cpu_all;
+#endif
+
+static void print_thread(const struct k_thread *cthread, void *user_data)
+{
+    const struct shell *sh = user_data;
+    struct k_thread *thread = (struct k_thread *)cthread;
+    const char *name = k_thread_name_get(thread);
+    char stack[24] = "-";
+    char cpu[12] = "-";
+
+#if defined(CONFIG_INIT_STACKS) && defined(CONFIG_THREAD_STACK_INFO)
+    size_t unused;
+    if (k_thread_stack_space_get(thread, &unused) == 0) {
+        snprintk(stack, sizeof(stack), "%u/%u", (unsigned int)unused,
+                 (unsigned int)thread->stack_info.size);
+    }
+#endif
+#if defined(CONFIG_THREAD_RUNTIME_STATS)
+    k_thread_runtime_stats_t usage;
+    if (cpu_all.execution_cycles > 0 && k_thread_runtime_stats_get(thread, &usage) == 0) {
+        uint32_t permille = (uint32_t)(usage.execution_cycles * 1000 /
+                                       cpu_all.execution_cycles);
+        snprintk(cpu, sizeof(cpu), "%u.%u%%", permille / 10, permille % 10);
+    }
+#endif
+
+    shell_print(sh, "%-16s %3d %15s %7s", name != NULL ? name : "?", thread->base.prio,
+                stack, cpu);
+}
+
+static int cmd_stats_threads(const struct shell *sh, size_t argc, char **argv)
+{
+#if defined(CONFIG_THREAD_RUNTIME_STATS)
+    if (k_thread_runtime_stats_all_get(&cpu_all) != 0) {
+        cpu_all.execution_cycles = 0;
+    }
+#endif
+    shell_print(sh, "%-16s %3s %15s %7s", "Thread", "Pri", "Stack unused", "CPU");
+    /* Unlocked: printing to the shell must not hold off the scheduler */
+    k_thread_foreach_unlocked(print_thread, (void *)sh);
+    return 0;
+}
+
+static int cmd_stats_reset(const struct shell *sh, size_t argc, char **argv)
+{
+    latency_hist_reset(&weather_station_adc_hist);
+    latency_hist_reset(&dns_cache_lookup_hist);
+    latency_hist_reset(&uplink_connect_hist);
+    latency_hist_reset(&uplink_request_hist);
+    latency_hist_reset(&pipeline_trace_hist);
+    shell_print(sh, "Latency histograms cleared");
+    return 0;
+}
+
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    cmd_stats_sensor(sh, argc, argv);
+    cmd_stats_queue(sh, argc, argv);
+    cmd_stats_uplink(sh, argc, argv);
+    cmd_stats_threads(sh, argc, argv);
+    return 0;
+}
+
+#if defined(CONFIG_WEATHER_STATION_ADAPTIVE_REPORTING)
+static int cmd_report(const struct shell *sh, size_t argc, char **argv)
+{
+    struct reporting_params p;
+    struct reporting_stats rep;
+
+    reporting_get_params(&p);
+    shell_print(sh, "Deadbands: speed " WS_SPEED_FMT " kph, direction " WS_DIRECTION_FMT
+                " degrees", WS_SPEED_ARGS(p.speed_deadband),
+                WS_DIRECTION_ARGS((int32_t)p.direction_deadband));
+    shell_print(sh, "Send at once: gust " WS_SPEED_FMT " kph, shift " WS_DIRECTION_FMT
+                " degrees; heartbeat %u ms", WS_SPEED_ARGS(p.gust),
+                WS_DIRECTION_ARGS((int32_t)p.shift), p.heartbeat_ms);
+
+    reporting_get_stats(&rep);
+    shell_print(sh, "%u of %u samples suppressed (%u%%); sent %u changes, %u gusts, %u shifts,"
+                " %u heartbeats", rep.suppressed, rep.samples,
+                rep.samples > 0 ? rep.suppressed * 100 / rep.samples : 0, rep.changes,
+                rep.gusts, rep.shifts, rep.heartbeats);
+    return 0;
+}
+
+/* Set the threshold named by the subcommand */
+static int cmd_report_set(const struct shell *sh, size_t argc, char **argv)
+{
+    struct reporting_params p;
+    int err = 0;
+    uint32_t value = (uint32_t)shell_strtoul(argv[1], 10, &err);
+
+    if (err != 0) {
+        shell_error(sh, "Invalid value: %s", argv[1]);
+        return -EINVAL;
+    }
+
+    reporting_get_params(&p);
+    if (strcmp(argv[0], "speed") == 0) {
+        p.speed_deadband = value;
+    } else if (strcmp(argv[0], "direction") == 0) {
+        p.direction_deadband = value;
+    } else if (strcmp(argv[0], "gust") == 0) {
+        p.gust = value;
+    } else if (strcmp(argv[0], "shift") == 0) {
+        p.shift = value;
+    } else {
+        p.heartbeat_ms = value;
+    }
+
+    if (reporting_set_params(&p) < 0) {
+        shell_error(sh, "Out of range: directions are at most 1800, the heartbeat at least 1");
+        return -EINVAL;
+    }
+    return cmd_report(sh, 1, argv);
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(ws_report_cmds,
+    SHELL_CMD_ARG(speed, NULL, "Speed deadband <0.01 kph>", cmd_report_set, 2, 0),
+    SHELL_CMD_ARG(direction, NULL, "Direction deadband <0.1 degrees>", cmd_report_set, 2, 0),
+    SHELL_CMD_ARG(gust, NULL, "Gust threshold <0.01 kph>, 0 for none", cmd_report_set, 2, 0),
+    SHELL_CMD_ARG(shift, NULL, "Direction shift threshold <0.1 degrees>, 0 for none",
+                  cmd_report_set, 2, 0),
+    SHELL_CMD_ARG(heartbeat, NULL, "Heartbeat interval <ms>", cmd_report_set, 2, 0),
+    SHELL_SUBCMD_SET_END
+);
+#endif /* CONFIG_WEATHER_STATION_ADAPTIVE_REPORTING */
+
+SHELL_STATIC_SUBCMD_SET_CREATE(ws_stats_cmds,
+    SHELL_CMD(sensor, NULL, "Anemometer pulse rates and ADC read times", cmd_stats_sensor),
+    SHELL_CMD(queue, NULL, "Sample queue and delivery latency", cmd_stats_queue),
+    SHELL_CMD(uplink, NULL, "Uplink counters and DNS, connect and request latencies",
+              cmd_stats_uplink),
+    SHELL_CMD(threads, NULL, "Stack unused and CPU usage per thread", cmd_stats_threads),
+    SHELL_CMD(reset, NULL, "Clear the latency histograms", cmd_stats_reset),
+    SHELL_SUBCMD_SET_END
+);
+
+/* Directives cannot go inside the macro arguments, so there is a set per configuration */
+#if defined(CONFIG_WEATHER_STATION_ADAPTIVE_REPORTING)
+SHELL_STATIC_SUBCMD_SET_CREATE(ws_cmds,
+    SHELL_CMD(stats, &ws_stats_cmds, "Show all runtime statistics", cmd_stats),
+    SHELL_CMD(report, &ws_report_cmds, "Show or set the adaptive reporting thresholds",
+              cmd_report),
+    SHELL_SUBCMD_SET_END
+);
+#else
+SHELL_STATIC_SUBCMD_SET_CREATE(ws_cmds,
+    SHELL_CMD(stats, &ws_stats_cmds, "Show all runtime statistics", cmd_stats),
+    SHELL_SUBCMD_SET_END
+);
+#endif
+
+SHELL_CMD_REGISTER(ws, &ws_cmds, "Weather station commands", NULL);
@@ -0,0 +1,309 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/storage/flash_map.h>
+#include <string.h>
+
+#include "journal.h"
+#include "uplink.h"
+
+#define JOURNAL_PARTITION_ID FIXED_PARTITION_ID(storage_partition)
+
+/* Well past what the 16 KiB storage partition of native_sim holds */
+#define OVERFILL 2000
+
+/*
+ * One-sample outages: a sample and a mark take under 40 bytes, so a 4 KiB sector holds at
+ * least 100 of them
+ */
+#define OUTAGES            400
+#define OUTAGES_PER_SECTOR 100
+
+/*---- Stand-in uplink ------------------------------------------------------*/
+
+static struct ws_sample sent[OVERFILL];
+static size_t sent_count;
+static int send_result;
+
+int uplink_send_samples(const struct ws_sample *samples, size_t count)
+{
+    if (send_result < 0) {
+        return send_result;
+    }
+
+    zassert_true(sent_count + count <= ARRAY_SIZE(sent), "more samples sent than appended");
+    for (size_t i = 1; i < count; i++) {
+        zassert_equal(samples[i].boot, samples[0].boot, "one upload across boots");
+    }
+    memcpy(&sent[sent_count], samples, count * sizeof(*samples));
+    sent_count += count;
+    return 0;
+}
+
+/*---- Helpers --------------------------------------------------------------*/
+
+static struct ws_sample sample(uint32_t i)
+{
+    return (struct ws_sample){
+        .timestamp = 1000LL * i,
+        .wind_speed = i % 10000,
+        .wind_direction = (i % 17 == 0) ? -1 : (i * 225) % 3600,
+        .station = 4011,
+    };
+}
+
+/**
+ * @brief Append samples first to first + count - 1, taken in this boot.
+ */
+static void append(uint32_t first, uint32_t count)
+{
+    for (uint32_t i = first; i < first + count; i++) {
+        struct ws_sample s = sample(i);
+
+        s.boot = journal_boot();
+        zassert_ok(journal_append(&s), "append %u", i);
+    }
+}
+
+static uint32_t replay_all(void)
+{
+    uint32_t total = 0;
+    int ret;
+
+    while ((ret = journal_replay()) > 0) {
+        total += ret;
+    }
+    zassert_ok(ret);
+    return total;
+}
+
+/**
+ * @brief Check that the samples sent so far are first, first + 1, ..., each sent once.
+ */
+static void check_sent(uint32_t first, uint32_t count)
+{
+    zassert_equal(sent_count, count, "%u samples sent, expected %u", sent_count, count);
+    for (uint32_t i = 0; i < count; i++) {
+        struct ws_sample s = sample(first + i);
+
+        zassert_equal(sent[i].timestamp, s.timestamp, "sample %u: uptime %lld", i,
+                      sent[i].timestamp);
+        zassert_equal(sent[i].wind_speed, s.wind_speed);
+        zassert_equal(sent[i].wind_direction, s.wind_direction);
+        zassert_equal(sent[i].station, s.station);
+    }
+}
+
+static void journal_before(void *fixture)
+{
+    const struct flash_area *fa;
+
+    ARG_UNUSED(fixture);
+
+    zassert_ok(flash_area_open(JOURNAL_PARTITION_ID, &fa));
+    zassert_ok(flash_area_erase(fa, 0, fa->fa_size));
+    flash_area_close(fa);
+
+    zassert_ok(journal_init());
+    zassert_equal(journal_pending(), 0);
+    sent_count = 0;
+    send_result = 0;
+}
+
+ZTEST_SUITE(journal, NULL, NULL, journal_before, NULL, NULL);
+
+/*---- Append and replay ----------------------------------------------------*/
+
+ZTEST(journal, test_append_replay)
+{
+    append(0, 100);
+    zassert_equal(journal_pending(), 100);
+
+    zassert_equal(journal_replay(), CONFIG_UPLINK_BULK_MAX_SAMPLES);
+    zassert_equal(journal_pending(), 100 - CONFIG_UPLINK_BULK_MAX_SAMPLES);
+
+    zassert_equal(replay_all(), 100 - CONFIG_UPLINK_BULK_MAX_SAMPLES);
+    zassert_equal(journal_pending(), 0);
+    check_sent(0, 100);
+}
+
+ZTEST(journal, test_failed_replay_keeps_samples)
+{
+    append(0, 10);
+
+    send_result = -EIO;
+    zassert_equal(journal_replay(), -EIO);
+    zassert_equal(journal_pending(), 10);
+
+    send_result = 0;
+    zassert_equal(replay_all(), 10);
+    check_sent(0, 10);
+}
+
+/*---- Rotation -------------------------------------------------------------*/
+
+ZTEST(journal, test_rotation_when_full)
+{
+    struct journal_stats before, after;
+
+    journal_get_stats(&before);
+    append(0, OVERFILL);
+    journal_get_stats(&after);
+
+    uint32_t dropped = after.dropped - before.dropped;
+
+    zassert_true(after.erases > before.erases, "no sector reclaimed");
+    zassert_true(dropped > 0, "nothing dropped");
+    zassert_equal(journal_pending() + dropped, OVERFILL);
+
+    /* The oldest samples are gone, the newest all replay in order */
+    uint32_t pending = journal_pending();
+
+    zassert_equal(replay_all(), pending);
+    check_sent(OVERFILL - pending, pending);
+}
+
+ZTEST(journal, test_wrap_around)
+{
+    struct journal_stats before, after;
+
+    /* Each round fills part of the ring and drains it, so sectors are reused in turn */
+    journal_get_stats(&before);
+    for (uint32_t round = 0; round < 8; round++) {
+        append(round * 250, 250);
+        zassert_equal(replay_all(), 250, "round %u", round);
+    }
+    journal_get_stats(&after);
+
+    zassert_equal(after.dropped, before.dropped);
+    zassert_true(after.erases > before.erases, "no sector reused");
+    check_sent(0, 8 * 250);
+}
+
+ZTEST(journal, test_outages_bound_erases)
+{
+    struct journal_stats before, after;
+
+    journal_get_stats(&before);
+    for (uint32_t i = 0; i < OUTAGES; i++) {
+        /* The link drops for one sample, which is replayed once it is back */
+        append(i, 1);
+        send_result = -EIO;
+        zassert_equal(journal_replay(), -EIO);
+        send_result = 0;
+        zassert_equal(replay_all(), 1, "outage %u", i);
+
+        if (i + 1 == OUTAGES_PER_SECTOR / 2) {
+            /* All still in the first sector, which is never erased while in use */
+            journal_get_stats(&after);
+            zassert_equal(after.erases, before.erases, "%u erases after %u outages",
+                          after.erases - before.erases, i + 1);
+        }
+    }
+    journal_get_stats(&after);
+
+    /* Only full sectors are erased */
+    zassert_true(after.erases - before.erases <= OUTAGES / OUTAGES_PER_SECTOR,
+                 "%u erases for %u outages", after.erases - before.erases, OUTAGES);
+    zassert_equal(after.dropped, before.dropped);
+    check_sent(0, OUTAGES);
+
+    /* And the delivered samples stay delivered across a reset */
+    zassert_ok(journal_init());
+    zassert_equal(journal_pending(), 0);
+    zassert_equal(journal_replay(), 0);
+}
+
+/*---- Restart --------------------------------------------------------------*/
+
+ZTEST(journal, test_restart_skips_delivered)
+{
+    append(0, 100);
+    zassert_equal(journal_replay(), CONFIG_UPLINK_BULK_MAX_SAMPLES);
+
+    /* A reset loses the cursor in RAM; the mark in flash still has it */
+    zassert_ok(journal_init());
+    zassert_equal(journal_pending(), 100 - CONFIG_UPLINK_BULK_MAX_SAMPLES);
+
+    replay_all();
+    check_sent(0, 100);
+}
+
+ZTEST(journal, test_restart_after_wrap_around)
+{
+    for (uint32_t round = 0; round < 5; round++) {
+        append(round * 250, 250);
+        replay_all();
+    }
+    append(1250, 100);
+    zassert_equal(journal_replay(), CONFIG_UPLINK_BULK_MAX_SAMPLES);
+
+    zassert_ok(journal_init());
+    zassert_equal(journal_pending(), 100 - CONFIG_UPLINK_BULK_MAX_SAMPLES);
+
+    replay_all();
+    check_sent(0, 1350);
+}
+
+ZTEST(journal, test_restart_after_drain)
+{
+    append(0, 50);
+    replay_all();
+
+    zassert_ok(journal_init());
+    zassert_equal(journal_pending(), 0);
+    zassert_equal(journal_replay(), 0);
+    check_sent(0, 50);
+}
+
+ZTEST(journal, test_restart_after_reclaiming_the_cursor)
+{
+    /* Part-replayed, then overfilled: the cursor's sector is reclaimed */
+    append(0, 100);
+    zassert_equal(journal_replay(), CONFIG_UPLINK_BULK_MAX_SAMPLES);
+    append(100, OVERFILL - 100);
+
+    uint32_t pending = journal_pending();
+
+    zassert_ok(journal_init());
+    zassert_equal(journal_pending(), pending);
+
+    sent_count = 0;
+    replay_all();
+    check_sent(OVERFILL - pending, pending);
+}
+
+/*---- Boot number ----------------------------------------------------------*/
+
+ZTEST(journal, test_boot_number)
+{
+    /* A formatted journal starts from boot 0, and each start counts one more */
+    zassert_equal(journal_boot(), 0);
+    append(0, 10);
+    zassert_ok(journal_init());
+    zassert_equal(journal_boot(), 1);
+
+    /* Kept however little is written, and once everything has been delivered */
+    zassert_ok(journal_init());
+    zassert_equal(journal_boot(), 2);
+    replay_all();
+    zassert_ok(journal_init());
+    zassert_equal(journal_boot(), 3);
+}
+
+ZTEST(journal, test_replay_across_boots)
+{
+    append(0, 10);
+    zassert_ok(journal_init());
+    append(10, 10);
+
+    /* Each upload carries the samples of one boot, with the boot they were taken in */
+    zassert_equal(journal_replay(), 10);
+    zassert_equal(journal_replay(), 10);
+    check_sent(0, 20);
+    for (uint32_t i = 0; i < 20; i++) {
+        zassert_equal(sent[i].boot, i < 10 ? 0 : 1, "sample %u: boot %u", i, sent[i].boot);
+    }
+}
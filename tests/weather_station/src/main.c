@@ -0,0 +1,161 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <stdlib.h>
+
+#include "weather_station.h"
+
+/* Edges toggled for the interrupt count */
+#define EDGES 1000
+
+/* Interval between speed readings while a pulse train settles, as the sampler would read */
+#define POLL_MS 50
+
+/* Largest speed error accepted, in 0.1 % */
+#define SPEED_TOLERANCE 20
+
+/* Anemometer closure rates swept (Hz) */
+static const uint16_t sweep_hz[] = { 1, 5, 20, 50, 100, 200, 400 };
+
+static WeatherStation station;
+static const struct weather_station_config config =
+    WEATHER_STATION_CONFIG_DT(DT_NODELABEL(weather_station0));
+
+/*---- Anemometer pulse trains ----------------------------------------------*/
+
+/*
+ * A timer toggles the emulated anemometer input, two edges per switch closure. The emulator
+ * runs the kit's callback in the timer's interrupt context, as the GPIO interrupt would.
+ */
+static int pulse_level;
+
+static void pulse_edge(struct k_timer *timer)
+{
+    pulse_level = !pulse_level;
+    gpio_emul_input_set(station.kit.gpio_dev, station.kit.wind_speed_pin, pulse_level);
+}
+
+static K_TIMER_DEFINE(pulse_timer, pulse_edge, NULL);
+
+/**
+ * @brief Start a pulse train of about @p hz switch closures per second.
+ *
+ * @return The closure rate actually generated, in mHz, since the timer runs in whole ticks.
+ */
+static uint32_t pulse_start(uint32_t hz)
+{
+    uint32_t ticks = MAX(1, k_us_to_ticks_near32(USEC_PER_SEC / 2 / hz));
+
+    k_timer_start(&pulse_timer, K_TICKS(ticks), K_TICKS(ticks));
+    return (uint32_t)((uint64_t)CONFIG_SYS_CLOCK_TICKS_PER_SEC * 1000 / (2 * ticks));
+}
+
+/**
+ * @brief Check the speed read at every swept rate in one speed mode.
+ *
+ * Each pulse train runs long enough to fill the filter and two measurement windows, with the
+ * speed read as the sampler would, before the last reading is compared with the rate.
+ */
+static void sweep(SFEWeatherMeterKitSpeedMode mode, uint8_t param)
+{
+    SFEWeatherMeterKit *kit = &station.kit;
+
+    for (size_t i = 0; i < ARRAY_SIZE(sweep_hz); i++) {
+        /* Let the previous train time out, so its closures are left out of the filter */
+        k_timer_stop(&pulse_timer);
+        if (mode != SFE_WMK_SPEED_WINDOW) {
+            k_msleep(SFE_WMK_PERIOD_TIMEOUT_MS + 100);
+        }
+        zassert_ok(SFEWeatherMeterKit_setWindSpeedMode(kit, mode, param));
+        SFEWeatherMeterKit_resetWindSpeedFilter(kit);
+
+        uint32_t mhz = pulse_start(sweep_hz[i]);
+        uint32_t settle_ms = MAX(2 * kit->calibrationParams.windSpeedMeasurementPeriodMillis +
+                                 POLL_MS, (param + 2) * MSEC_PER_SEC / sweep_hz[i]);
+        for (uint32_t t = 0; t < settle_ms; t += POLL_MS) {
+            k_msleep(POLL_MS);
+            (void)SFEWeatherMeterKit_getWindSpeedCentiKph(kit);
+        }
+        uint32_t speed = SFEWeatherMeterKit_getWindSpeedCentiKph(kit);
+
+        uint32_t expected = (uint32_t)((uint64_t)kit->centiKphPerCountPerSec * mhz / 1000);
+        uint32_t error = (uint32_t)((uint64_t)abs((int32_t)(speed - expected)) * 1000 /
+                                    MAX(1, expected));
+        zassert_true(error <= SPEED_TOLERANCE, "mode %d, %u Hz: speed %u, expected %u", mode,
+                     sweep_hz[i], speed, expected);
+    }
+    k_timer_stop(&pulse_timer);
+}
+
+/*---- Setup ----------------------------------------------------------------*/
+
+static void *weather_station_setup(void)
+{
+    zassert_ok(weather_station_init(&station, &config));
+    return NULL;
+}
+
+static void weather_station_after(void *fixture)
+{
+    k_timer_stop(&pulse_timer);
+    zassert_ok(SFEWeatherMeterKit_setWindSpeedMode(&station.kit, SFE_WMK_SPEED_WINDOW, 0));
+}
+
+ZTEST_SUITE(weather_station, NULL, weather_station_setup, NULL, weather_station_after, NULL);
+
+/*---- Anemometer -----------------------------------------------------------*/
+
+ZTEST(weather_station, test_edges_counted)
+{
+    SFEWeatherMeterKit *kit = &station.kit;
+    uint32_t head;
+
+    zassert_ok(gpio_emul_input_set(kit->gpio_dev, kit->wind_speed_pin, 0));
+    pulse_level = 0;
+    head = (uint32_t)atomic_get(&kit->pulseHead);
+
+    for (int i = 0; i < EDGES; i++) {
+        zassert_ok(gpio_emul_input_set(kit->gpio_dev, kit->wind_speed_pin, (i + 1) & 1));
+    }
+    zassert_equal((uint32_t)atomic_get(&kit->pulseHead) - head, EDGES);
+}
+
+ZTEST(weather_station, test_speed_window)
+{
+    sweep(SFE_WMK_SPEED_WINDOW, 0);
+}
+
+ZTEST(weather_station, test_speed_period_avg)
+{
+    sweep(SFE_WMK_SPEED_PERIOD_AVG, 4);
+}
+
+ZTEST(weather_station, test_speed_period_ema)
+{
+    sweep(SFE_WMK_SPEED_PERIOD_EMA, 3);
+}
+
+/*---- Vane -----------------------------------------------------------------*/
+
+ZTEST(weather_station, test_vane_positions)
+{
+    SFEWeatherMeterKit *kit = &station.kit;
+
+    for (int i = 0; i < WMK_NUM_ANGLES; i++) {
+        /* The middle of the calibration value's code, so the emulator converts it back */
+        int32_t mv = 2 * kit->calibrationParams.vaneADCValues[i] + 1;
+
+        adc_raw_to_millivolts(adc_ref_internal(kit->adc_dev), kit->wind_dir_adc_gain,
+                              kit->adcResolutionBits + 1, &mv);
+        zassert_ok(adc_emul_const_value_set(kit->adc_dev, kit->wind_dir_adc_channel, mv));
+
+        zassert_equal(SFEWeatherMeterKit_getWindDirectionDeciDegrees(kit),
+                      i * SFE_WIND_VANE_DECIDEGREES_PER_INDEX, "position %d", i);
+    }
+}
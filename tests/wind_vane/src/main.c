@@ -0,0 +1,216 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+
+#include "weather_station.h"
+#include "wind_math.h"
+#include "wind_vane.h"
+
+/* Long enough for any block started before a change of voltage to be finished */
+#define SETTLE_MS 50
+/* Samples in one report: several blocks from each vane */
+#define REPORT_MS 200
+
+static WeatherStation station;
+static const struct weather_station_config config =
+    WEATHER_STATION_CONFIG_DT(DT_NODELABEL(weather_station0));
+
+/*---- ADC without sequence support -----------------------------------------*/
+
+/*
+ * Accepts single conversions only, like ADC drivers without sequence intervals, so the
+ * vane thread falls back to paced reads.
+ */
+static int16_t seq_less_raw;
+
+static int seq_less_channel_setup(const struct device *dev,
+                                  const struct adc_channel_cfg *channel_cfg)
+{
+    return 0;
+}
+
+static int seq_less_read(const struct device *dev, const struct adc_sequence *sequence)
+{
+    if (sequence->options != NULL) {
+        return -ENOTSUP;
+    }
+    if (sequence->buffer_size < sizeof(int16_t)) {
+        return -ENOMEM;
+    }
+    *(int16_t *)sequence->buffer = seq_less_raw;
+    return 0;
+}
+
+static DEVICE_API(adc, seq_less_api) = {
+    .channel_setup = seq_less_channel_setup,
+    .read = seq_less_read,
+    .ref_internal = 3300,
+};
+
+DEVICE_DEFINE(seq_less_adc, "seq_less_adc", NULL, NULL, NULL, NULL, POST_KERNEL,
+              CONFIG_KERNEL_INIT_PRIORITY_DEVICE, &seq_less_api);
+
+/*---- Helpers --------------------------------------------------------------*/
+
+static int32_t position_mv(const SFEWeatherMeterKit *kit, int index)
+{
+    /* The middle of the calibration value's code, so the emulator converts it back exactly */
+    int32_t mv = 2 * kit->calibrationParams.vaneADCValues[index] + 1;
+
+    adc_raw_to_millivolts(adc_ref_internal(kit->adc_dev), kit->wind_dir_adc_gain,
+                          kit->adcResolutionBits + 1, &mv);
+    return mv;
+}
+
+static void vane_set(const SFEWeatherMeterKit *kit, int index)
+{
+    zassert_ok(adc_emul_const_value_set(kit->adc_dev, kit->wind_dir_adc_channel,
+                                        position_mv(kit, index)));
+}
+
+/* Vane swinging between two positions, one conversion each in turn */
+struct swing {
+    uint32_t mv[2];
+    uint32_t next;
+};
+
+static int swing_value(const struct device *dev, unsigned int chan, void *data,
+                       uint32_t *result)
+{
+    struct swing *swing = data;
+
+    *result = swing->mv[swing->next++ & 1];
+    return 0;
+}
+
+static void vane_swing(const SFEWeatherMeterKit *kit, struct swing *swing, int a, int b)
+{
+    swing->mv[0] = position_mv(kit, a);
+    swing->mv[1] = position_mv(kit, b);
+    swing->next = 0;
+    zassert_ok(adc_emul_value_func_set(kit->adc_dev, kit->wind_dir_adc_channel,
+                                       swing_value, swing));
+}
+
+/**
+ * @brief Take the report of a period started after the vane settled.
+ */
+static void take_report(const SFEWeatherMeterKit *kit, struct wind_vane_report *report)
+{
+    k_msleep(SETTLE_MS);
+    wind_vane_take_report(kit, report);
+    k_msleep(REPORT_MS);
+    wind_vane_take_report(kit, report);
+
+    zassert_true(report->samples > 0, "no samples");
+    zassert_equal(report->invalid, 0, "%u invalid samples", report->invalid);
+}
+
+static void check_mean(const struct wind_vane_report *report, int32_t ddeg)
+{
+    /* wm_atan2_ddeg() is within about 0.3 degrees */
+    zassert_true(wm_angle_diff_ddeg(report->mean, ddeg) <= 3, "mean %d, expected %d",
+                 report->mean, ddeg);
+}
+
+static void *wind_vane_setup(void)
+{
+    zassert_ok(weather_station_init(&station, &config));
+    return NULL;
+}
+
+/*
+ * The fallback to paced reads is for good, so test_paced_fallback must run last; ztest
+ * runs the tests of a suite in name order.
+ */
+ZTEST_SUITE(wind_vane, NULL, wind_vane_setup, NULL, NULL, NULL);
+
+/*---- Block sequences ------------------------------------------------------*/
+
+ZTEST(wind_vane, test_block_sequence)
+{
+    struct wind_vane_stats before, after;
+    struct wind_vane_report report;
+
+    for (int i = 0; i < WMK_NUM_ANGLES; i++) {
+        wind_vane_get_stats(&before);
+        vane_set(&station.kit, i);
+        take_report(&station.kit, &report);
+        wind_vane_get_stats(&after);
+
+        /* Whole blocks from one extra_samplings sequence each */
+        zassert_false(after.paced, "fell back to paced reads");
+        zassert_equal(after.errors, before.errors);
+        zassert_true(after.samples - before.samples >= report.samples);
+        zassert_equal((after.samples - before.samples) % CONFIG_WEATHER_STATION_VANE_BLOCK, 0);
+
+        check_mean(&report, i * SFE_WIND_VANE_DECIDEGREES_PER_INDEX);
+        zassert_true(report.variance <= 1, "position %d: variance %u", i, report.variance);
+    }
+}
+
+/*---- Vector mean and variance ---------------------------------------------*/
+
+ZTEST(wind_vane, test_mean_and_variance)
+{
+    static struct swing swing;
+    struct wind_vane_report report;
+
+    /* Between north and east: mean 45 degrees, resultant length cos(45) */
+    vane_swing(&station.kit, &swing, WMK_ANGLE_0_0, WMK_ANGLE_90_0);
+    take_report(&station.kit, &report);
+    check_mean(&report, 450);
+    zassert_within(report.variance, 293, 2, "variance %u", report.variance);
+
+    /* Across north: the mean wraps to 0, not the arithmetic 180 */
+    vane_swing(&station.kit, &swing, WMK_ANGLE_337_5, WMK_ANGLE_22_5);
+    take_report(&station.kit, &report);
+    check_mean(&report, 0);
+    zassert_within(report.variance, 77, 2, "variance %u", report.variance);
+
+    /* Opposite positions cancel out */
+    vane_swing(&station.kit, &swing, WMK_ANGLE_90_0, WMK_ANGLE_270_0);
+    take_report(&station.kit, &report);
+    zassert_true(report.variance >= 998, "variance %u", report.variance);
+}
+
+/*---- Paced fallback -------------------------------------------------------*/
+
+ZTEST(wind_vane, test_paced_fallback)
+{
+    static SFEWeatherMeterKit kit;
+    struct wind_vane_stats stats;
+    struct wind_vane_report report;
+
+    SFEWeatherMeterKit_init(&kit, DEVICE_GET(seq_less_adc), 0, NULL, 0);
+    seq_less_raw = kit.calibrationParams.vaneADCValues[WMK_ANGLE_112_5];
+    vane_set(&station.kit, WMK_ANGLE_202_5);
+    zassert_ok(wind_vane_start(&kit));
+
+    /* The first sequence on the new vane is refused */
+    for (int i = 0; i < 100; i++) {
+        wind_vane_get_stats(&stats);
+        if (stats.paced) {
+            break;
+        }
+        k_msleep(10);
+    }
+    zassert_true(stats.paced, "no fallback to paced reads");
+
+    /* Both vanes are now read one conversion at a time */
+    take_report(&kit, &report);
+    check_mean(&report, 1125);
+    zassert_true(report.variance <= 1);
+
+    take_report(&station.kit, &report);
+    check_mean(&report, 2025);
+    zassert_true(report.variance <= 1);
+
+    wind_vane_get_stats(&stats);
+    zassert_equal(stats.errors, 0);
+}
@@ -0,0 +1,155 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <string.h>
+
+#include "wire.h"
+
+/*
+ * The expected frames below decode back to the samples they were encoded from with
+ * tools/ws_wire_decode.py, so the encoder and the server's decoder agree on them.
+ */
+
+static uint8_t buf[WIRE_PACKED_FRAME_SIZE(32)];
+
+/**
+ * @brief Encode @p samples and compare the frame with @p expected.
+ */
+static void check_frame(bool packed, const struct ws_sample *samples, size_t count,
+                        const uint8_t *expected, size_t expected_len)
+{
+    int len = packed ? wire_encode_packed(buf, sizeof(buf), samples, count) :
+                       wire_encode(buf, sizeof(buf), samples, count);
+
+    zassert_equal(len, expected_len, "frame of %d bytes, expected %u", len, expected_len);
+    for (size_t i = 0; i < expected_len; i++) {
+        zassert_equal(buf[i], expected[i], "byte %u is %#04x, expected %#04x", i, buf[i],
+                      expected[i]);
+    }
+}
+
+ZTEST_SUITE(wire, NULL, NULL, NULL, NULL, NULL);
+
+/*---- Plain frames ---------------------------------------------------------*/
+
+ZTEST(wire, test_plain)
+{
+    /* Two stations, an unknown direction, full scale values and a base past 32 bits */
+    static const struct ws_sample samples[] = {
+        { .timestamp = 4294968296LL, .wind_speed = 1234, .wind_direction = -1, .station = 7,
+          .boot = 300 },
+        { .timestamp = 4294969296LL, .wind_speed = 0, .wind_direction = 3599, .station = 5,
+          .boot = 300 },
+        { .timestamp = 4295169296LL, .wind_speed = 65535, .wind_direction = 0, .station = 7,
+          .boot = 300 },
+    };
+    static const uint8_t expected[] = {
+        0x57, 0x04, 0x07, 0x00, 0x2c, 0x01, 0xe8, 0x03, 0x00, 0x00, 0x03, 0x00,
+        0x00, 0xd2, 0x04, 0xff, 0xff, 0x03, 0xe8, 0x07, 0x00, 0x00, 0x0f, 0x0e,
+        0x04, 0xc0, 0x9a, 0x0c, 0xff, 0xff, 0x00, 0x00, 0x66, 0xba,
+    };
+
+    check_frame(false, samples, ARRAY_SIZE(samples), expected, sizeof(expected));
+}
+
+/*---- Packed frames --------------------------------------------------------*/
+
+ZTEST(wire, test_packed_repeat_runs)
+{
+    /*
+     * A steady wind at a steady rate, with one faster sample in the middle: the runs either
+     * side are cut at WIRE_PACKED_REPEAT_MAX repeats
+     */
+    struct ws_sample samples[20];
+
+    for (size_t i = 0; i < ARRAY_SIZE(samples); i++) {
+        samples[i] = (struct ws_sample){
+            .timestamp = 100000 + 1000 * i,
+            .wind_speed = i == 12 ? 1250 : 1200,
+            .wind_direction = 450,
+            .station = 3,
+            .boot = 2,
+        };
+    }
+    static const uint8_t expected[] = {
+        0x57, 0x05, 0x03, 0x00, 0x02, 0x00, 0xa0, 0x86, 0x01, 0x00, 0x14,
+        0x0c, 0xe0, 0x12, 0x04, /* first sample: speed and direction in sectors */
+        0xe2, 0xd0, 0x0f,       /* interval, 7 repeats */
+        0x40,                   /* 2 repeats */
+        0x04, 0x64,             /* speed up */
+        0xc4, 0x63,             /* speed down, 6 repeats */
+        0x0f, 0xae,
+    };
+
+    check_frame(true, samples, ARRAY_SIZE(samples), expected, sizeof(expected));
+}
+
+ZTEST(wire, test_packed_station_eviction)
+{
+    /*
+     * One more station than there are slots takes the first station's slot, so the first
+     * station starts over when it comes back while the last keeps its state
+     */
+    struct ws_sample samples[WIRE_PACKED_STATIONS + 3];
+
+    for (size_t i = 0; i <= WIRE_PACKED_STATIONS; i++) {
+        samples[i] = (struct ws_sample){
+            .timestamp = 5000 + 100 * i,
+            .wind_speed = 500 + i,
+            .wind_direction = WIRE_PACKED_SECTOR * i,
+            .station = 1 + i,
+            .boot = 2,
+        };
+    }
+    samples[WIRE_PACKED_STATIONS + 1] = (struct ws_sample){
+        .timestamp = 6000, .wind_speed = 500, .wind_direction = 0, .station = 1, .boot = 2,
+    };
+    samples[WIRE_PACKED_STATIONS + 2] = (struct ws_sample){
+        .timestamp = 6100, .wind_speed = 508, .wind_direction = 1800, .station = 9, .boot = 2,
+    };
+    static const uint8_t expected[] = {
+        0x57, 0x05, 0x01, 0x00, 0x02, 0x00, 0x88, 0x13, 0x00, 0x00, 0x0b,
+        0x0c, 0xe8, 0x07, 0x00,
+        0x0f, 0x02, 0xc8, 0x01, 0xea, 0x07, 0x02,
+        0x0f, 0x02, 0xc8, 0x01, 0xec, 0x07, 0x04,
+        0x0f, 0x02, 0xc8, 0x01, 0xee, 0x07, 0x06,
+        0x0f, 0x02, 0xc8, 0x01, 0xf0, 0x07, 0x08,
+        0x0f, 0x02, 0xc8, 0x01, 0xf2, 0x07, 0x0a,
+        0x0f, 0x02, 0xc8, 0x01, 0xf4, 0x07, 0x0c,
+        0x0f, 0x02, 0xc8, 0x01, 0xf6, 0x07, 0x0e,
+        0x0f, 0x02, 0xc8, 0x01, 0xf8, 0x07, 0x10, /* station 9 takes station 1's slot */
+        0x0f, 0x0f, 0x90, 0x03, 0xe8, 0x07, 0x00, /* station 1 again, from a speed of 0 */
+        0x03, 0x10, 0x90, 0x03,                   /* station 9 again, speed and direction kept */
+        0x19, 0x86,
+    };
+
+    check_frame(true, samples, ARRAY_SIZE(samples), expected, sizeof(expected));
+}
+
+/*---- Errors ---------------------------------------------------------------*/
+
+ZTEST(wire, test_errors)
+{
+    struct ws_sample samples[2] = {
+        { .timestamp = 1000, .wind_speed = 100, .wind_direction = 0, .station = 1, .boot = 1 },
+        { .timestamp = 2000, .wind_speed = 100, .wind_direction = 0, .station = 1, .boot = 1 },
+    };
+
+    /* A buffer too small for the records */
+    zassert_equal(wire_encode(buf, WIRE_HEADER_SIZE + WIRE_CRC_SIZE + 4, samples, 2), -ENOMEM);
+    zassert_equal(wire_encode_packed(buf, WIRE_HEADER_SIZE + WIRE_CRC_SIZE + 2, samples, 2),
+                  -ENOMEM);
+
+    /* Samples out of order, which would need a negative interval */
+    samples[1].timestamp = 999;
+    zassert_equal(wire_encode(buf, sizeof(buf), samples, 2), -EINVAL);
+    zassert_equal(wire_encode_packed(buf, sizeof(buf), samples, 2), -EINVAL);
+
+    /* Samples from different boots */
+    samples[1].timestamp = 2000;
+    samples[1].boot = 2;
+    zassert_equal(wire_encode(buf, sizeof(buf), samples, 2), -EINVAL);
+    zassert_equal(wire_encode_packed(buf, sizeof(buf), samples, 2), -EINVAL);
+}
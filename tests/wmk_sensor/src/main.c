@@ -0,0 +1,174 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/rtio/rtio.h>
+
+#include "wmk_sensor.h"
+
+#define WMK_NODE DT_NODELABEL(weather_station0)
+
+static const struct device *const wmk = DEVICE_DT_GET(WMK_NODE);
+
+SENSOR_DT_READ_IODEV(wmk_iodev, WMK_NODE,
+                     { SENSOR_CHAN_WMK_WIND_SPEED, 0 },
+                     { SENSOR_CHAN_WMK_WIND_DIRECTION, 0 });
+RTIO_DEFINE(wmk_rtio, 1, 1);
+
+/*---- Helpers --------------------------------------------------------------*/
+
+/**
+ * @brief Set the emulated vane voltage to the middle of an ADC code.
+ */
+static void vane_set_code(const SFEWeatherMeterKit *kit, int32_t code)
+{
+    int32_t mv = 2 * code + 1;
+
+    adc_raw_to_millivolts(adc_ref_internal(kit->adc_dev), kit->wind_dir_adc_gain,
+                          kit->adcResolutionBits + 1, &mv);
+    zassert_ok(adc_emul_const_value_set(kit->adc_dev, kit->wind_dir_adc_channel, mv));
+}
+
+/**
+ * @brief Blow @p closures switch closures within one measurement window.
+ *
+ * Waits for two windows first, so the next read reports the window ending then: 2.4 kph
+ * per closure per second.
+ *
+ * @return The expected speed in 0.01 kph.
+ */
+static uint32_t blow(const SFEWeatherMeterKit *kit, uint32_t closures)
+{
+    k_msleep(2 * kit->calibrationParams.windSpeedMeasurementPeriodMillis + 10);
+
+    /* Two edges per closure, ending low as it started */
+    for (uint32_t i = 0; i < 2 * closures; i++) {
+        zassert_ok(gpio_emul_input_set(kit->gpio_dev, kit->wind_speed_pin, (i + 1) & 1));
+    }
+    k_msleep(10);
+    return closures * kit->centiKphPerCountPerSec;
+}
+
+/**
+ * @brief Convert a decoded Q31 reading back to fixed point with @p scale units per unit.
+ */
+static int32_t q31_to_fixed(q31_t value, int8_t shift, int32_t scale)
+{
+    /* value = reading * 2^(31 - shift), rounded to nearest */
+    return (int32_t)((((int64_t)value * scale) + BIT64(30 - shift)) >> (31 - shift));
+}
+
+static int decode(const uint8_t *buf, int chan, struct sensor_q31_data *out)
+{
+    const struct sensor_decoder_api *decoder;
+    struct sensor_chan_spec spec = { .chan_type = chan, .chan_idx = 0 };
+    uint32_t fit = 0;
+
+    zassert_ok(sensor_get_decoder(wmk, &decoder));
+    return decoder->decode(buf, spec, &fit, 1, out);
+}
+
+static void *wmk_sensor_setup(void)
+{
+    zassert_true(device_is_ready(wmk), "sensor not ready");
+
+    /* Anemometer input low, as blow() leaves it */
+    zassert_ok(gpio_emul_input_set(wmk_sensor_station(wmk)->kit.gpio_dev,
+                                   wmk_sensor_station(wmk)->kit.wind_speed_pin, 0));
+    return NULL;
+}
+
+ZTEST_SUITE(wmk_sensor, NULL, wmk_sensor_setup, NULL, NULL, NULL);
+
+/*---- Fetch and get --------------------------------------------------------*/
+
+ZTEST(wmk_sensor, test_fetch_get)
+{
+    SFEWeatherMeterKit *kit = &wmk_sensor_station(wmk)->kit;
+    struct sensor_value val;
+
+    vane_set_code(kit, kit->calibrationParams.vaneADCValues[WMK_ANGLE_67_5]);
+    zassert_equal(blow(kit, 5), 1200);
+
+    zassert_ok(sensor_sample_fetch(wmk));
+    zassert_ok(sensor_channel_get(wmk, SENSOR_CHAN_WMK_WIND_SPEED, &val));
+    zassert_equal(val.val1, 12, "speed %d.%06d", val.val1, val.val2);
+    zassert_equal(val.val2, 0, "speed %d.%06d", val.val1, val.val2);
+    zassert_ok(sensor_channel_get(wmk, SENSOR_CHAN_WMK_WIND_DIRECTION, &val));
+    zassert_equal(val.val1, 67, "direction %d.%06d", val.val1, val.val2);
+    zassert_equal(val.val2, 500000, "direction %d.%06d", val.val1, val.val2);
+
+    zassert_equal(sensor_sample_fetch_chan(wmk, SENSOR_CHAN_AMBIENT_TEMP), -ENOTSUP);
+    zassert_equal(sensor_channel_get(wmk, SENSOR_CHAN_AMBIENT_TEMP, &val), -ENOTSUP);
+}
+
+ZTEST(wmk_sensor, test_fetch_unknown_direction)
+{
+    SFEWeatherMeterKit *kit = &wmk_sensor_station(wmk)->kit;
+    struct sensor_value val;
+    int32_t code = 0;
+
+    /* A voltage between the calibrated positions */
+    while (SFEWeatherMeterKit_decodeVaneIndex(kit, code) >= 0) {
+        code++;
+        zassert_true(code < BIT(kit->adcResolutionBits), "every code decodes");
+    }
+    vane_set_code(kit, code);
+
+    zassert_ok(sensor_sample_fetch(wmk));
+    zassert_equal(sensor_channel_get(wmk, SENSOR_CHAN_WMK_WIND_DIRECTION, &val), -ENODATA);
+    zassert_ok(sensor_channel_get(wmk, SENSOR_CHAN_WMK_WIND_SPEED, &val));
+}
+
+/*---- Read and decode ------------------------------------------------------*/
+
+ZTEST(wmk_sensor, test_read_decode)
+{
+    SFEWeatherMeterKit *kit = &wmk_sensor_station(wmk)->kit;
+    struct sensor_q31_data speed, direction;
+    uint8_t buf[32];
+
+    /* The largest bearing and a speed near the top of the ring's range */
+    vane_set_code(kit, kit->calibrationParams.vaneADCValues[WMK_ANGLE_337_5]);
+    uint32_t expected = blow(kit, SFE_WMK_PULSE_RING_SIZE / 2 - 1);
+    int64_t before_ns = k_uptime_get() * NSEC_PER_MSEC;
+
+    zassert_ok(sensor_read(&wmk_iodev, &wmk_rtio, buf, sizeof(buf)));
+
+    zassert_equal(decode(buf, SENSOR_CHAN_WMK_WIND_SPEED, &speed), 1);
+    zassert_equal(speed.header.reading_count, 1);
+    zassert_true(speed.header.base_timestamp_ns >= before_ns);
+    zassert_within(q31_to_fixed(speed.readings[0].value, speed.shift, 100), expected, 1,
+                   "speed %d, expected %u", q31_to_fixed(speed.readings[0].value,
+                                                         speed.shift, 100), expected);
+
+    zassert_equal(decode(buf, SENSOR_CHAN_WMK_WIND_DIRECTION, &direction), 1);
+    zassert_equal(direction.header.base_timestamp_ns, speed.header.base_timestamp_ns);
+    zassert_within(q31_to_fixed(direction.readings[0].value, direction.shift, 10), 3375, 1,
+                   "direction %d", q31_to_fixed(direction.readings[0].value,
+                                                direction.shift, 10));
+}
+
+ZTEST(wmk_sensor, test_read_unknown_direction)
+{
+    SFEWeatherMeterKit *kit = &wmk_sensor_station(wmk)->kit;
+    struct sensor_q31_data out;
+    uint8_t buf[32];
+    int32_t code = 0;
+
+    while (SFEWeatherMeterKit_decodeVaneIndex(kit, code) >= 0) {
+        code++;
+    }
+    vane_set_code(kit, code);
+
+    zassert_ok(sensor_read(&wmk_iodev, &wmk_rtio, buf, sizeof(buf)));
+    zassert_equal(decode(buf, SENSOR_CHAN_WMK_WIND_DIRECTION, &out), -ENODATA);
+    zassert_equal(decode(buf, SENSOR_CHAN_WMK_WIND_SPEED, &out), 1);
+    zassert_equal(decode(buf, SENSOR_CHAN_AMBIENT_TEMP, &out), -ENOTSUP);
+}
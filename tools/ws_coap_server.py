@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Local stand-in for the CoAP server of the weather station CoAP uplink.
+
+Accepts the CSV POSTs of CONFIG_UPLINK_COAP on UDP: non-confirmable live samples, and
+confirmable bulk uploads, acknowledged with 2.04 Changed. Uploads larger than a block
+arrive block-wise (Block1, RFC 7959): each block but the last is acknowledged with
+2.31 Continue, and the blocks are put back together. It prints the message and sample
+rates every interval:
+
+    ws_coap_server.py --port 5683
+
+Point the build at it with CONFIG_UPLINK_COAP_SERVER="127.0.0.1". Each upload is checked as
+a batch, like the HTTP sink's bulk POSTs. An upload that fails the check is reported on
+stderr; the pytest scenarios in app/pytest read the checked uploads through
+CoapServer.uploads and CoapServer.errors. With --verbose every message is printed as well.
+"""
+
+import argparse
+import collections
+import socketserver
+import struct
+import sys
+import threading
+import time
+
+import ws_http_sink
+
+TYPE_CON, TYPE_NON, TYPE_ACK, TYPE_RST = 0, 1, 2, 3
+METHOD_POST = 0x02
+CHANGED, CONTINUE = 0x44, 0x5F                       # 2.04, 2.31
+BAD_REQUEST, NOT_FOUND, NOT_ALLOWED = 0x80, 0x84, 0x85
+INCOMPLETE = 0x88                                    # 4.08 Request Entity Incomplete
+OPTION_URI_PATH, OPTION_CONTENT_FORMAT, OPTION_BLOCK1 = 11, 12, 27
+
+
+class MessageError(ValueError):
+    pass
+
+
+def parse_message(data):
+    """Split a CoAP message into (type, code, message id, token, options, payload)."""
+    if len(data) < 4 or data[0] >> 6 != 1:
+        raise MessageError("not a CoAP version 1 message")
+    msg_type, tkl = (data[0] >> 4) & 3, data[0] & 0x0F
+    code, mid = data[1], struct.unpack_from(">H", data, 2)[0]
+    if tkl > 8 or len(data) < 4 + tkl:
+        raise MessageError("bad token length %d" % tkl)
+    token, pos = data[4:4 + tkl], 4 + tkl
+
+    options, number = [], 0
+    while pos < len(data) and data[pos] != 0xFF:
+        delta, length = data[pos] >> 4, data[pos] & 0x0F
+        pos += 1
+        values = []
+        for nibble in (delta, length):
+            if nibble == 13:
+                values.append(data[pos] + 13)
+                pos += 1
+            elif nibble == 14:
+                values.append(struct.unpack_from(">H", data, pos)[0] + 269)
+                pos += 2
+            elif nibble == 15:
+                raise MessageError("reserved option nibble")
+            else:
+                values.append(nibble)
+        number += values[0]
+        if pos + values[1] > len(data):
+            raise MessageError("truncated option %d" % number)
+        options.append((number, data[pos:pos + values[1]]))
+        pos += values[1]
+
+    payload = data[pos + 1:] if pos < len(data) else b""
+    return msg_type, code, mid, token, options, payload
+
+
+def encode_option(delta, value):
+    def nibble(n):
+        if n < 13:
+            return n, b""
+        if n < 269:
+            return 13, bytes([n - 13])
+        return 14, struct.pack(">H", n - 269)
+
+    d, d_ext = nibble(delta)
+    length, l_ext = nibble(len(value))
+    return bytes([(d << 4) | length]) + d_ext + l_ext + value
+
+
+def option_uint(value):
+    return int.from_bytes(value, "big")
+
+
+def uint_option(value):
+    return value.to_bytes((value.bit_length() + 7) // 8, "big")
+
+
+class CoapServer:
+    path = "ws"
+    verbose = False
+    lock = threading.Lock()
+    # Checked uploads as (type, number of blocks, samples), and the ones that failed
+    uploads = []
+    errors = []
+    counters = [0, 0]
+    # Block-wise uploads in progress by client, as (next block number, size, data)
+    partial = {}
+    # Responses to recent confirmable messages by (client, message id), for duplicates
+    recent = collections.OrderedDict()
+
+
+class CoapHandler(socketserver.BaseRequestHandler):
+    def log(self, text):
+        if CoapServer.verbose:
+            sys.stdout.write("%s:%d %s\n" % (self.client_address + (text,)))
+            sys.stdout.flush()
+
+    def fail(self, text):
+        sys.stderr.write("%s:%d %s\n" % (self.client_address + (text,)))
+        with CoapServer.lock:
+            CoapServer.errors.append(text)
+
+    def reply(self, mid, token, code, block1=None):
+        message = bytes([0x40 | (TYPE_ACK << 4) | len(token), code]) + \
+            struct.pack(">H", mid) + token
+        if block1 is not None:
+            message += encode_option(OPTION_BLOCK1, uint_option(block1))
+        return message
+
+    def record(self, msg_type, blocks, payload):
+        try:
+            samples = ws_http_sink.parse_batch(payload, "text/plain")
+        except ws_http_sink.BatchError as err:
+            self.fail(str(err))
+            return False
+        with CoapServer.lock:
+            CoapServer.uploads.append((msg_type, blocks, samples))
+            CoapServer.counters[0] += 1
+            CoapServer.counters[1] += len(samples)
+        return True
+
+    def post(self, msg_type, token, options, payload):
+        """Take in a POST; returns the response code and Block1 value to echo."""
+        path = "/".join(value.decode(errors="replace")
+                        for number, value in options if number == OPTION_URI_PATH)
+        if path != CoapServer.path:
+            return NOT_FOUND, None
+        block1 = [option_uint(value) for number, value in options if number == OPTION_BLOCK1]
+        if not block1:
+            return (CHANGED if self.record(msg_type, 1, payload) else BAD_REQUEST), None
+
+        num, more, size = block1[0] >> 4, bool(block1[0] & 8), 16 << (block1[0] & 7)
+        client = self.client_address
+        with CoapServer.lock:
+            expected, block_size, data = CoapServer.partial.pop(client, (0, size, b""))
+        if num == 0:
+            # A new upload, or the client gave up on the previous one and starts again
+            expected, block_size, data = 0, size, b""
+        if num != expected or size != block_size or (more and len(payload) != size):
+            self.fail("block %d of %d bytes, expected block %d of %d" %
+                      (num, len(payload), expected, block_size))
+            return INCOMPLETE, None
+
+        data += payload
+        if more:
+            with CoapServer.lock:
+                CoapServer.partial[client] = (num + 1, size, data)
+            return CONTINUE, block1[0]
+        return (CHANGED if self.record(msg_type, num + 1, data) else BAD_REQUEST), block1[0]
+
+    def handle(self):
+        data, sock = self.request
+        try:
+            msg_type, code, mid, token, options, payload = parse_message(data)
+        except (MessageError, IndexError, struct.error) as err:
+            self.fail(str(err))
+            return
+        self.log("%s %d.%02d mid %d\n%s" % (("CON", "NON", "ACK", "RST")[msg_type],
+                                            code >> 5, code & 0x1F, mid,
+                                            payload.decode(errors="replace")))
+        if msg_type not in (TYPE_CON, TYPE_NON):
+            return
+
+        key = (self.client_address, mid)
+        with CoapServer.lock:
+            response = CoapServer.recent.get(key)
+        if response is None:
+            if code != METHOD_POST:
+                code, block1 = NOT_ALLOWED, None
+            else:
+                code, block1 = self.post(msg_type, token, options, payload)
+            if msg_type != TYPE_CON:
+                return
+            response = self.reply(mid, token, code, block1)
+            with CoapServer.lock:
+                CoapServer.recent[key] = response
+                while len(CoapServer.recent) > 64:
+                    CoapServer.recent.popitem(last=False)
+        elif msg_type != TYPE_CON:
+            return
+        sock.sendto(response, self.client_address)
+
+
+def serve(port, path="ws", verbose=False):
+    """Start the server on a background thread and return it."""
+    CoapServer.path = path
+    CoapServer.verbose = verbose
+    server = socketserver.ThreadingUDPServer(("", port), CoapHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def report(interval):
+    while True:
+        time.sleep(interval)
+        with CoapServer.lock:
+            uploads, samples = CoapServer.counters
+            CoapServer.counters[:] = [0, 0]
+        sys.stdout.write("%.1f uploads/s, %.1f samples/s\n" %
+                         (uploads / interval, samples / interval))
+        sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=5683, help="UDP port to listen on")
+    parser.add_argument("--path", default="ws", help="resource path (CONFIG_UPLINK_COAP_PATH)")
+    parser.add_argument("--interval", type=float, default=5.0,
+                        help="seconds between rate reports")
+    parser.add_argument("--verbose", action="store_true", help="print every message")
+    args = parser.parse_args()
+
+    server = serve(args.port, args.path, args.verbose)
+    try:
+        report(args.interval)
+    except KeyboardInterrupt:
+        server.shutdown()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,186 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Local stand-in for the weather station HTTP server.
+
+Accepts the live GET /add.php requests and the bulk POSTs of the HTTP uplink on
+keep-alive connections, answers each with an empty 200, and prints the request
+and sample rates every interval:
+
+    ws_http_sink.py --port 8080
+
+The native_sim build sends to 127.0.0.1:8080 (CONFIG_HTTP_HOST, CONFIG_HTTP_PORT).
+Packed bulk uploads (CONFIG_UPLINK_PACKED) are decoded with ws_wire_decode.py.
+With --verbose every request line and body is printed as well.
+
+Each bulk POST is checked as a batch: a non-empty run of at most --max-samples
+samples, each with a station, a boot number, an uptime, a speed and a direction,
+in non-decreasing time order per station and boot. A body that fails the check is reported
+on stderr; the pytest scenarios in app/pytest read the checked batches through
+SinkHandler.batches and SinkHandler.errors.
+"""
+
+import argparse
+import http.server
+import sys
+import threading
+import time
+
+import ws_wire_decode
+
+
+class BatchError(ValueError):
+    pass
+
+
+def parse_batch(body, content_type, max_samples=None):
+    """Decode a bulk POST body into (station, boot, timestamp, speed, direction) samples.
+
+    Raises BatchError if the body is not a well-formed, time-ordered batch.
+    """
+    if content_type == "application/octet-stream":
+        try:
+            samples = ws_wire_decode.decode_frame(body)
+        except ws_wire_decode.FrameError as err:
+            raise BatchError(str(err)) from None
+    else:
+        samples = []
+        for number, line in enumerate(body.decode(errors="replace").splitlines(), 1):
+            if not line.strip():
+                continue
+            fields = line.split(",")
+            if len(fields) != 5:
+                raise BatchError("line %d: %d fields, expected 5" % (number, len(fields)))
+            try:
+                direction = float(fields[4])
+                samples.append((int(fields[0]), int(fields[1]), int(fields[2]),
+                                float(fields[3]), None if direction < 0 else direction))
+            except ValueError:
+                raise BatchError("line %d: malformed sample %r" % (number, line)) from None
+
+    if not samples:
+        raise BatchError("empty batch")
+    if max_samples is not None and len(samples) > max_samples:
+        raise BatchError("%d samples, at most %d expected" % (len(samples), max_samples))
+
+    last = {}
+    for station, boot, timestamp, speed, direction in samples:
+        if timestamp < last.get((station, boot), timestamp):
+            raise BatchError("station %d: uptime %d after %d in boot %d" %
+                             (station, timestamp, last[(station, boot)], boot))
+        if speed < 0 or (direction is not None and not 0 <= direction < 360):
+            raise BatchError("station %d: speed %.2f, direction %s out of range" %
+                             (station, speed, direction))
+        last[(station, boot)] = timestamp
+    return samples
+
+
+class Counters:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.requests = 0
+        self.samples = 0
+        self.bytes = 0
+
+    def add(self, samples, length):
+        with self.lock:
+            self.requests += 1
+            self.samples += samples
+            self.bytes += length
+
+    def take(self):
+        with self.lock:
+            values = (self.requests, self.samples, self.bytes)
+            self.requests = self.samples = self.bytes = 0
+        return values
+
+
+class SinkHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    counters = None
+    verbose = False
+    max_samples = None
+    # Checked bulk POSTs, one list of samples each, the frame version of each (None for
+    # CSV), and the bodies that failed
+    lock = threading.Lock()
+    batches = []
+    versions = []
+    errors = []
+
+    def reply(self, samples, body=b"", text=None):
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+        self.counters.add(samples, len(body))
+        if self.verbose:
+            sys.stdout.write("%s %s\n" % (self.requestline,
+                                          body.decode(errors="replace") if text is None
+                                          else text))
+
+    def do_GET(self):
+        self.reply(1 if self.path.startswith("/add.php") else 0)
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        content_type = self.headers.get("Content-Type")
+        try:
+            samples = parse_batch(body, content_type, self.max_samples)
+        except BatchError as err:
+            sys.stderr.write("%s: %s\n" % (self.client_address[0], err))
+            with self.lock:
+                self.errors.append(str(err))
+            samples = []
+        else:
+            with self.lock:
+                self.batches.append(samples)
+                self.versions.append(body[1] if content_type == "application/octet-stream"
+                                     else None)
+        self.reply(len(samples), body, "".join(
+            "%d,%d,%d,%.2f,%s\n" % (station, boot, timestamp, speed,
+                                    "" if direction is None else "%.1f" % direction)
+            for station, boot, timestamp, speed, direction in samples))
+
+    def log_message(self, format, *args):
+        pass
+
+
+def report(counters, interval):
+    while True:
+        time.sleep(interval)
+        requests, samples, length = counters.take()
+        sys.stdout.write("%.1f requests/s, %.1f samples/s, %d body bytes/request\n" %
+                         (requests / interval, samples / interval,
+                          length // requests if requests else 0))
+        sys.stdout.flush()
+
+
+def serve(port, verbose=False, max_samples=None):
+    """Start the sink on a background thread and return the server."""
+    SinkHandler.counters = Counters()
+    SinkHandler.verbose = verbose
+    SinkHandler.max_samples = max_samples
+    server = http.server.ThreadingHTTPServer(("", port), SinkHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8080, help="TCP port to listen on")
+    parser.add_argument("--interval", type=float, default=5.0,
+                        help="seconds between rate reports")
+    parser.add_argument("--max-samples", type=int,
+                        help="largest batch accepted (CONFIG_UPLINK_BULK_MAX_SAMPLES)")
+    parser.add_argument("--verbose", action="store_true", help="print every request")
+    args = parser.parse_args()
+
+    server = serve(args.port, args.verbose, args.max_samples)
+    try:
+        report(SinkHandler.counters, args.interval)
+    except KeyboardInterrupt:
+        server.shutdown()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
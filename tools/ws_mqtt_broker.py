@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Local stand-in for the MQTT broker of the weather station MQTT uplink.
+
+Speaks just enough MQTT 3.1.1 for CONFIG_UPLINK_MQTT: CONNECT with a persistent or clean
+session, PUBLISH at QoS 0 or 1 (acknowledged with PUBACK), PINGREQ and DISCONNECT. It
+prints the message and sample rates every interval:
+
+    ws_mqtt_broker.py --port 1883
+
+Point the build at it with CONFIG_UPLINK_MQTT_BROKER="127.0.0.1". Each PUBLISH is checked:
+the topic is the prefix and a station id, and the payload is one
+"boot,uptime,speed,direction" record per line in non-decreasing time order per boot. A message that fails the check is reported on
+stderr; the pytest scenarios in app/pytest read the checked messages through
+Broker.messages and Broker.errors. With --verbose every packet is printed as well.
+"""
+
+import argparse
+import socketserver
+import struct
+import sys
+import threading
+import time
+
+CONNECT, CONNACK, PUBLISH, PUBACK = 1, 2, 3, 4
+PINGREQ, PINGRESP, DISCONNECT = 12, 13, 14
+
+
+class ProtocolError(ValueError):
+    pass
+
+
+def parse_publish(topic, payload, prefix):
+    """Decode a PUBLISH into (station, boot, timestamp, speed, direction) samples.
+
+    Raises ProtocolError if the topic or the payload is malformed or out of order.
+    """
+    if not topic.startswith(prefix) or not topic[len(prefix):].isdigit():
+        raise ProtocolError("topic %r is not %s<station>" % (topic, prefix))
+    station = int(topic[len(prefix):])
+
+    samples = []
+    for number, line in enumerate(payload.decode(errors="replace").splitlines(), 1):
+        fields = line.split(",")
+        if len(fields) != 4:
+            raise ProtocolError("line %d: %d fields, expected 4" % (number, len(fields)))
+        try:
+            direction = float(fields[3])
+            samples.append((station, int(fields[0]), int(fields[1]), float(fields[2]),
+                            None if direction < 0 else direction))
+        except ValueError:
+            raise ProtocolError("line %d: malformed record %r" % (number, line)) from None
+        if len(samples) > 1 and samples[-1][1] == samples[-2][1] and \
+                samples[-1][2] < samples[-2][2]:
+            raise ProtocolError("line %d: uptime %d after %d" %
+                                (number, samples[-1][2], samples[-2][2]))
+    if not samples:
+        raise ProtocolError("empty payload")
+    return samples
+
+
+class Broker:
+    prefix = "weather/"
+    verbose = False
+    # Client ids with a persistent session
+    sessions = set()
+    # Checked publishes, (client id, samples) each, and the ones that failed; the CONNECTs
+    # as (client id, clean session, session present)
+    lock = threading.Lock()
+    messages = []
+    errors = []
+    connects = []
+    counters = [0, 0]
+
+
+def get_string(data, pos):
+    if pos + 2 > len(data):
+        raise ProtocolError("truncated string")
+    (length,) = struct.unpack_from(">H", data, pos)
+    if pos + 2 + length > len(data):
+        raise ProtocolError("truncated string")
+    return data[pos + 2:pos + 2 + length].decode(), pos + 2 + length
+
+
+class BrokerHandler(socketserver.BaseRequestHandler):
+    def read(self, size):
+        data = b""
+        while len(data) < size:
+            chunk = self.request.recv(size - len(data))
+            if not chunk:
+                raise EOFError
+            data += chunk
+        return data
+
+    def read_packet(self):
+        (header,) = self.read(1)
+        length = 0
+        for shift in range(0, 28, 7):
+            (byte,) = self.read(1)
+            length |= (byte & 0x7F) << shift
+            if not byte & 0x80:
+                break
+        else:
+            raise ProtocolError("remaining length over 4 bytes")
+        return header >> 4, header & 0x0F, self.read(length)
+
+    def log(self, text):
+        if Broker.verbose:
+            sys.stdout.write("%s %s\n" % (self.client_id or self.client_address[0], text))
+            sys.stdout.flush()
+
+    def connect(self, data):
+        protocol, pos = get_string(data, 0)
+        if protocol != "MQTT" or len(data) < pos + 4 or data[pos] != 4:
+            raise ProtocolError("not MQTT 3.1.1")
+        flags = data[pos + 1]
+        keepalive = struct.unpack_from(">H", data, pos + 2)[0]
+        self.client_id, _ = get_string(data, pos + 4)
+        clean = bool(flags & 0x02)
+
+        with Broker.lock:
+            present = not clean and self.client_id in Broker.sessions
+            if clean:
+                Broker.sessions.discard(self.client_id)
+            else:
+                Broker.sessions.add(self.client_id)
+            Broker.connects.append((self.client_id, clean, present))
+        self.request.sendall(bytes([CONNACK << 4, 2, int(present), 0]))
+        self.log("CONNECT clean=%d keepalive=%d, session present=%d" %
+                 (clean, keepalive, present))
+
+    def publish(self, flags, data):
+        qos = (flags >> 1) & 3
+        topic, pos = get_string(data, 0)
+        if qos > 1:
+            raise ProtocolError("QoS %d not supported" % qos)
+        if qos == 1:
+            (packet_id,) = struct.unpack_from(">H", data, pos)
+            pos += 2
+        payload = data[pos:]
+
+        try:
+            samples = parse_publish(topic, payload, Broker.prefix)
+        except ProtocolError as err:
+            sys.stderr.write("%s: %s\n" % (self.client_id, err))
+            with Broker.lock:
+                Broker.errors.append(str(err))
+        else:
+            with Broker.lock:
+                Broker.messages.append((self.client_id, samples))
+                Broker.counters[0] += 1
+                Broker.counters[1] += len(samples)
+        if qos == 1:
+            self.request.sendall(bytes([PUBACK << 4, 2]) + struct.pack(">H", packet_id))
+        self.log("PUBLISH %s qos=%d\n%s" % (topic, qos, payload.decode(errors="replace")))
+
+    def handle(self):
+        self.client_id = None
+        try:
+            packet_type, flags, data = self.read_packet()
+            if packet_type != CONNECT:
+                raise ProtocolError("first packet type %d, not CONNECT" % packet_type)
+            self.connect(data)
+
+            while True:
+                packet_type, flags, data = self.read_packet()
+                if packet_type == PUBLISH:
+                    self.publish(flags, data)
+                elif packet_type == PINGREQ:
+                    self.request.sendall(bytes([PINGRESP << 4, 0]))
+                    self.log("PINGREQ")
+                elif packet_type == DISCONNECT:
+                    self.log("DISCONNECT")
+                    return
+                else:
+                    raise ProtocolError("packet type %d not supported" % packet_type)
+        except EOFError:
+            self.log("connection closed")
+        except (ProtocolError, UnicodeDecodeError, struct.error) as err:
+            sys.stderr.write("%s: %s\n" % (self.client_id or self.client_address[0], err))
+            with Broker.lock:
+                Broker.errors.append(str(err))
+
+
+class BrokerServer(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def serve(port, prefix="weather/", verbose=False):
+    """Start the broker on a background thread and return the server."""
+    Broker.prefix = prefix
+    Broker.verbose = verbose
+    server = BrokerServer(("", port), BrokerHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def report(interval):
+    while True:
+        time.sleep(interval)
+        with Broker.lock:
+            messages, samples = Broker.counters
+            Broker.counters[:] = [0, 0]
+        sys.stdout.write("%.1f messages/s, %.1f samples/s\n" %
+                         (messages / interval, samples / interval))
+        sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=1883, help="TCP port to listen on")
+    parser.add_argument("--prefix", default="weather/",
+                        help="topic prefix (CONFIG_UPLINK_MQTT_TOPIC_PREFIX)")
+    parser.add_argument("--interval", type=float, default=5.0,
+                        help="seconds between rate reports")
+    parser.add_argument("--verbose", action="store_true", help="print every packet")
+    args = parser.parse_args()
+
+    server = serve(args.port, args.prefix, args.verbose)
+    try:
+        report(args.interval)
+    except KeyboardInterrupt:
+        server.shutdown()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Decode weather station binary uplink frames (see app/include/wire.h).
+
+Both the plain (version 4) and the packed (version 5) frames are decoded.
+
+Listen for frames on a UDP port and print one CSV line per sample:
+
+    ws_wire_decode.py --listen 4011
+
+or decode hex-encoded frames, one per line, from a file or stdin:
+
+    ws_wire_decode.py --hex frames.txt
+
+The pytest scenarios in app/pytest start the listener with serve() and read the
+decoded frames through Receiver.frames and the ones that failed through
+Receiver.errors.
+"""
+
+import argparse
+import socket
+import socketserver
+import struct
+import sys
+import threading
+
+WIRE_MAGIC = 0x57
+WIRE_VERSION = 4
+WIRE_VERSION_PACKED = 5
+WIRE_HEADER = struct.Struct("<BBHHIB")
+WIRE_DIR_INVALID = 0xFFFF
+
+WIRE_PACKED_STATION = 0x01
+WIRE_PACKED_DT = 0x02
+WIRE_PACKED_SPEED = 0x04
+WIRE_PACKED_DIR_SAME = 0
+WIRE_PACKED_DIR_SECTORS = 1
+WIRE_PACKED_DIR_DELTA = 2
+WIRE_PACKED_DIR_UNKNOWN = 3
+WIRE_PACKED_SECTOR = 225
+WIRE_PACKED_STATIONS = 8
+
+
+class FrameError(ValueError):
+    pass
+
+
+def crc16_ccitt(data, seed=0xFFFF):
+    """Zephyr's crc16_ccitt(): reflected polynomial 0x1021, no final XOR."""
+    crc = seed
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc
+
+
+def get_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise FrameError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def get_zigzag(data, pos):
+    value, pos = get_varint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode_frame(frame):
+    """Return [(station_id, boot, uptime_ms, speed_kph, direction_deg or None), ...]."""
+    if len(frame) < WIRE_HEADER.size + 2:
+        raise FrameError("frame too short")
+    (crc,) = struct.unpack_from("<H", frame, len(frame) - 2)
+    if crc16_ccitt(frame[:-2]) != crc:
+        raise FrameError("CRC mismatch")
+
+    magic, version, station, boot, base, count = WIRE_HEADER.unpack_from(frame)
+    if magic != WIRE_MAGIC or version not in (WIRE_VERSION, WIRE_VERSION_PACKED):
+        raise FrameError("unknown magic/version %#x/%d" % (magic, version))
+    if version == WIRE_VERSION_PACKED:
+        return decode_packed(frame, station, boot, base, count)
+
+    samples = []
+    pos = WIRE_HEADER.size
+    timestamp = base
+    for _ in range(count):
+        dsta, pos = get_varint(frame, pos)
+        station = (station + ((dsta >> 1) ^ -(dsta & 1))) & 0xFFFF
+        dt, pos = get_varint(frame, pos)
+        if pos + 4 > len(frame) - 2:
+            raise FrameError("truncated record")
+        speed, direction = struct.unpack_from("<HH", frame, pos)
+        pos += 4
+        timestamp += dt
+        samples.append((station, boot, timestamp, speed / 100.0,
+                        None if direction == WIRE_DIR_INVALID else direction / 10.0))
+    if pos != len(frame) - 2:
+        raise FrameError("trailing bytes")
+    return samples
+
+
+class PackedStation:
+    """State of a station in a packed frame, as kept by the encoder."""
+
+    def __init__(self, station, timestamp):
+        self.station = station
+        self.timestamp = timestamp
+        self.dt = 0
+        self.speed = 0
+        self.direction = None
+
+
+def decode_packed(frame, station, boot, base, count):
+    end = len(frame) - 2
+    stations = []
+    seen = 0
+    samples = []
+    pos = WIRE_HEADER.size
+    timestamp = base
+    while len(samples) < count:
+        if pos >= end:
+            raise FrameError("truncated record")
+        tag = frame[pos]
+        pos += 1
+        if tag & WIRE_PACKED_STATION:
+            dsta, pos = get_zigzag(frame, pos)
+            station = (station + dsta) & 0xFFFF
+
+        st = next((s for s in stations if s.station == station), None)
+        if st is None:
+            st = PackedStation(station, timestamp)
+            if len(stations) < WIRE_PACKED_STATIONS:
+                stations.append(st)
+            else:
+                stations[seen % WIRE_PACKED_STATIONS] = st
+            seen += 1
+
+        if tag & WIRE_PACKED_DT:
+            ddt, pos = get_zigzag(frame, pos)
+            st.dt += ddt
+        if tag & WIRE_PACKED_SPEED:
+            dspeed, pos = get_zigzag(frame, pos)
+            st.speed = (st.speed + dspeed) & 0xFFFF
+        dir_mode = (tag >> 3) & 3
+        if dir_mode == WIRE_PACKED_DIR_UNKNOWN:
+            st.direction = None
+        elif dir_mode != WIRE_PACKED_DIR_SAME:
+            ddir, pos = get_zigzag(frame, pos)
+            if dir_mode == WIRE_PACKED_DIR_SECTORS:
+                ddir *= WIRE_PACKED_SECTOR
+            st.direction = ((st.direction or 0) + ddir) % 3600
+
+        for _ in range(1 + (tag >> 5)):
+            st.timestamp += st.dt
+            samples.append((station, boot, st.timestamp, st.speed / 100.0,
+                            None if st.direction is None else st.direction / 10.0))
+        timestamp = st.timestamp
+        if pos > end:
+            raise FrameError("truncated record")
+    if len(samples) != count:
+        raise FrameError("sample count mismatch")
+    if pos != end:
+        raise FrameError("trailing bytes")
+    return samples
+
+
+def print_frame(frame, out):
+    for station, boot, timestamp, speed, direction in decode_frame(frame):
+        out.write("%d,%d,%d,%.2f,%s\n" % (station, boot, timestamp, speed,
+                                          "" if direction is None else "%.1f" % direction))
+    out.flush()
+
+
+class Receiver:
+    lock = threading.Lock()
+    # Decoded frames, one list of samples each, and the frames that failed
+    frames = []
+    errors = []
+
+
+class FrameHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        frame = self.request[0]
+        try:
+            samples = decode_frame(frame)
+        except FrameError as err:
+            sys.stderr.write("%s: %s\n" % (self.client_address[0], err))
+            with Receiver.lock:
+                Receiver.errors.append(str(err))
+        else:
+            with Receiver.lock:
+                Receiver.frames.append(samples)
+
+
+def serve(port):
+    """Start the listener on a background thread and return the server.
+
+    Frames are handled one at a time, in the order they arrive.
+    """
+    server = socketserver.UDPServer(("", port), FrameHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    group = parser.add_mutually_exclusive_group(required=True)
+    group.add_argument("--listen", type=int, metavar="PORT", help="UDP port to listen on")
+    group.add_argument("--hex", metavar="FILE", help="file of hex frames, '-' for stdin")
+    args = parser.parse_args()
+
+    sys.stdout.write("station,boot,uptime_ms,speed_kph,direction_deg\n")
+
+    if args.listen is not None:
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.bind(("", args.listen))
+        while True:
+            frame, peer = sock.recvfrom(2048)
+            try:
+                print_frame(frame, sys.stdout)
+            except FrameError as err:
+                sys.stderr.write("%s: %s\n" % (peer[0], err))
+
+    src = sys.stdin if args.hex == "-" else open(args.hex)
+    status = 0
+    for line in src:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            print_frame(bytes.fromhex(line), sys.stdout)
+        except (FrameError, ValueError) as err:
+            sys.stderr.write("%s\n" % err)
+            status = 1
+    return status
+
+
+if __name__ == "__main__":
+    sys.exit(main())